@@ -0,0 +1,243 @@
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+
+#include "bitboard.h"
+
+using namespace std;
+
+namespace bitboard {
+  // C++11 constexpr functions are a single return, so the tables are built from recursion and
+  // the initializer lists are spelled out by macros (one call per square).
+  #define BB_RANK(f, a, r) \
+      f(a, 8 * r + 0), f(a, 8 * r + 1), f(a, 8 * r + 2), f(a, 8 * r + 3), \
+      f(a, 8 * r + 4), f(a, 8 * r + 5), f(a, 8 * r + 6), f(a, 8 * r + 7)
+  #define BB_SQUARES(f, a) \
+      BB_RANK(f, a, 0), BB_RANK(f, a, 1), BB_RANK(f, a, 2), BB_RANK(f, a, 3), \
+      BB_RANK(f, a, 4), BB_RANK(f, a, 5), BB_RANK(f, a, 6), BB_RANK(f, a, 7)
+  #define BB_ROW(f, s1) { BB_SQUARES(f, s1) }
+  #define BB_ROW_RANK(f, r) \
+      BB_ROW(f, 8 * r + 0), BB_ROW(f, 8 * r + 1), BB_ROW(f, 8 * r + 2), BB_ROW(f, 8 * r + 3), \
+      BB_ROW(f, 8 * r + 4), BB_ROW(f, 8 * r + 5), BB_ROW(f, 8 * r + 6), BB_ROW(f, 8 * r + 7)
+  #define BB_ROWS(f) \
+      BB_ROW_RANK(f, 0), BB_ROW_RANK(f, 1), BB_ROW_RANK(f, 2), BB_ROW_RANK(f, 3), \
+      BB_ROW_RANK(f, 4), BB_ROW_RANK(f, 5), BB_ROW_RANK(f, 6), BB_ROW_RANK(f, 7)
+
+  constexpr bool onBoard(int a, int b) {
+    return 0 <= a && a <= 7 && 0 <= b && b <= 7;
+  }
+
+  constexpr int sign(int a) {
+    return (a > 0) - (a < 0);
+  }
+
+  // Single square (rank + dA, file + dB) from square if it's on the board.
+  constexpr bitboard_t leaper(int square, int dA, int dB) {
+    return onBoard(square / 8 + dA, square % 8 + dB) ?
+        squareBit(squareIndex(square / 8 + dA, square % 8 + dB)) : 0;
+  }
+
+  // Empty board ray starting at (a, b) and continuing in (dA, dB).
+  constexpr bitboard_t ray(int a, int b, int dA, int dB) {
+    return onBoard(a, b) ? squareBit(squareIndex(a, b)) | ray(a + dA, b + dB, dA, dB) : 0;
+  }
+
+  constexpr bitboard_t rayFrom(int square, int dA, int dB) {
+    return ray(square / 8 + dA, square % 8 + dB, dA, dB);
+  }
+
+  constexpr bool aligned(int s1, int s2) {
+    return s1 != s2 && (
+        s1 / 8 == s2 / 8 || s1 % 8 == s2 % 8 ||
+        s1 / 8 - s2 / 8 == s1 % 8 - s2 % 8 || s1 / 8 - s2 / 8 == s2 % 8 - s1 % 8);
+  }
+
+  constexpr bitboard_t knightAttacksOf(int, int square) {
+    return leaper(square, 2, 1) | leaper(square, 2, -1) | leaper(square, -2, 1) |
+           leaper(square, -2, -1) | leaper(square, 1, 2) | leaper(square, 1, -2) |
+           leaper(square, -1, 2) | leaper(square, -1, -2);
+  }
+
+  constexpr bitboard_t kingAttacksOf(int, int square) {
+    return leaper(square, 0, -1) | leaper(square, 1, -1) | leaper(square, 1, 0) |
+           leaper(square, 1, 1) | leaper(square, 0, 1) | leaper(square, -1, 1) |
+           leaper(square, -1, 0) | leaper(square, -1, -1);
+  }
+
+  constexpr bitboard_t pawnAttacksOf(int isWhite, int square) {
+    return isWhite ? leaper(square, 1, -1) | leaper(square, 1, 1) :
+                     leaper(square, -1, -1) | leaper(square, -1, 1);
+  }
+
+  constexpr bitboard_t betweenOf(int s1, int s2) {
+    return !aligned(s1, s2) ? 0 :
+        rayFrom(s1, sign(s2 / 8 - s1 / 8), sign(s2 % 8 - s1 % 8)) &
+        rayFrom(s2, sign(s1 / 8 - s2 / 8), sign(s1 % 8 - s2 % 8));
+  }
+
+  constexpr bitboard_t lineOf(int s1, int s2) {
+    return !aligned(s1, s2) ? 0 :
+        rayFrom(s1, sign(s2 / 8 - s1 / 8), sign(s2 % 8 - s1 % 8)) |
+        rayFrom(s1, sign(s1 / 8 - s2 / 8), sign(s1 % 8 - s2 % 8)) | squareBit(s1);
+  }
+
+  constexpr bitboard_t KNIGHT_ATTACKS[64] = { BB_SQUARES(knightAttacksOf, 0) };
+  constexpr bitboard_t KING_ATTACKS[64] = { BB_SQUARES(kingAttacksOf, 0) };
+  constexpr bitboard_t PAWN_ATTACKS[2][64] = {
+    { BB_SQUARES(pawnAttacksOf, false) }, { BB_SQUARES(pawnAttacksOf, true) }};
+
+  constexpr bitboard_t BETWEEN[64][64] = { BB_ROWS(betweenOf) };
+  constexpr bitboard_t LINE[64][64] = { BB_ROWS(lineOf) };
+
+  #undef BB_ROWS
+  #undef BB_ROW_RANK
+  #undef BB_ROW
+  #undef BB_SQUARES
+  #undef BB_RANK
+
+  static_assert(KNIGHT_ATTACKS[0] == 0x20400ULL, "knight on a1 attacks b3 and c2");
+  static_assert(KING_ATTACKS[63] == 0x40C0000000000000ULL, "king on h8 attacks g8, g7, h7");
+  static_assert(PAWN_ATTACKS[true][8] == 0x20000ULL, "white pawn on a2 attacks b3");
+  static_assert(BETWEEN[0][63] == 0x0040201008040200ULL, "a1 to h8 diagonal");
+  static_assert(LINE[1][2] == RANK_1, "b1 and c1 share the first rank");
+
+  Magic BISHOP_MAGICS[64];
+  Magic ROOK_MAGICS[64];
+
+  // Sum over squares of 2^(relevant bits), 5248 for bishops and 102400 for rooks.
+  bitboard_t BISHOP_TABLE[5248];
+  bitboard_t ROOK_TABLE[102400];
+
+  const int BISHOP_DELTAS[4][2] = {{1, 1}, {1, -1}, {-1, 1}, {-1, -1}};
+  const int ROOK_DELTAS[4][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+
+
+  static bitboard_t slidingAttacks_slow(const int deltas[4][2], int square, bitboard_t occupied) {
+    bitboard_t attacks = 0;
+    for (int d = 0; d < 4; d++) {
+      int a = square / 8 + deltas[d][0];
+      int b = square % 8 + deltas[d][1];
+      while (onBoard(a, b)) {
+        bitboard_t bit = squareBit(squareIndex(a, b));
+        attacks |= bit;
+        if (occupied & bit) {
+          break;
+        }
+        a += deltas[d][0];
+        b += deltas[d][1];
+      }
+    }
+    return attacks;
+  }
+
+
+  bitboard_t bishopAttacks_slow(int square, bitboard_t occupied) {
+    return slidingAttacks_slow(BISHOP_DELTAS, square, occupied);
+  }
+
+
+  bitboard_t rookAttacks_slow(int square, bitboard_t occupied) {
+    return slidingAttacks_slow(ROOK_DELTAS, square, occupied);
+  }
+
+
+  // xorshift64*, fixed seed so the magics (and table layout) are the same every run.
+  static uint64_t magicRandom(uint64_t &state) {
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * 2685821657736338717ULL;
+  }
+
+
+  static void initMagics(const int deltas[4][2], Magic magics[64], bitboard_t *table) {
+    static bitboard_t occupancy[4096];
+    static bitboard_t reference[4096];
+    static int epoch[4096];
+
+    uint64_t seed = 0x9E3779B97F4A7C15ULL;
+    int attempt = 0;
+    memset(epoch, 0, sizeof(epoch));
+
+    for (int square = 0; square < 64; square++) {
+      // Edge squares never block (there is nothing behind them) so they aren't relevant.
+      bitboard_t edges = ((RANK_1 | RANK_8) & ~(RANK_1 << (8 * (square / 8)))) |
+                         ((FILE_A | FILE_H) & ~(FILE_A << (square % 8)));
+
+      Magic &m = magics[square];
+      m.mask = slidingAttacks_slow(deltas, square, 0) & ~edges;
+      m.shift = 64 - popCount(m.mask);
+      m.attacks = table;
+
+      // Enumerate all subsets of mask (Carry-Rippler).
+      int size = 0;
+      bitboard_t occupied = 0;
+      do {
+        occupancy[size] = occupied;
+        reference[size] = slidingAttacks_slow(deltas, square, occupied);
+        size++;
+        occupied = (occupied - m.mask) & m.mask;
+      } while (occupied);
+
+      // Try sparse random numbers till one maps every subset without a bad collision.
+      bool found = false;
+      while (!found) {
+        m.magic = magicRandom(seed) & magicRandom(seed) & magicRandom(seed);
+        if (popCount((m.mask * m.magic) >> 56) < 6) {
+          continue;
+        }
+
+        attempt++;
+        found = true;
+        for (int i = 0; i < size; i++) {
+          int index = (occupancy[i] * m.magic) >> m.shift;
+          if (epoch[index] < attempt) {
+            epoch[index] = attempt;
+            m.attacks[index] = reference[i];
+          } else if (m.attacks[index] != reference[i]) {
+            found = false;
+            break;
+          }
+        }
+      }
+
+      table += size;
+    }
+  }
+
+
+  static void init() {
+    // The constexpr line tables should agree with walking the rays.
+    for (int s1 = 0; s1 < 64; s1++) {
+      for (int s2 = 0; s2 < 64; s2++) {
+        bitboard_t ends = squareBit(s1) | squareBit(s2);
+        bitboard_t between = 0;
+        bitboard_t line = 0;
+        if (s1 != s2 && (bishopAttacks_slow(s1, 0) & squareBit(s2))) {
+          line = (bishopAttacks_slow(s1, 0) & bishopAttacks_slow(s2, 0)) | ends;
+          between = bishopAttacks_slow(s1, ends) & bishopAttacks_slow(s2, ends);
+        }
+        if (s1 != s2 && (rookAttacks_slow(s1, 0) & squareBit(s2))) {
+          line = (rookAttacks_slow(s1, 0) & rookAttacks_slow(s2, 0)) | ends;
+          between = rookAttacks_slow(s1, ends) & rookAttacks_slow(s2, ends);
+        }
+        assert( BETWEEN[s1][s2] == between );
+        assert( LINE[s1][s2] == line );
+      }
+    }
+
+    initMagics(BISHOP_DELTAS, BISHOP_MAGICS, BISHOP_TABLE);
+    initMagics(ROOK_DELTAS, ROOK_MAGICS, ROOK_TABLE);
+
+    assert( BISHOP_MAGICS[63].attacks + (1 << (64 - BISHOP_MAGICS[63].shift)) ==
+            BISHOP_TABLE + 5248 );
+    assert( ROOK_MAGICS[63].attacks + (1 << (64 - ROOK_MAGICS[63].shift)) ==
+            ROOK_TABLE + 102400 );
+  }
+
+
+  // Find the magics before main (Board only needs them once generating moves).
+  struct BitboardInit {
+    BitboardInit() { init(); }
+  } bitboardInit;
+}
@@ -0,0 +1,85 @@
+#ifndef BITBOARD_H
+#define BITBOARD_H
+
+#include <cstdint>
+
+using namespace std;
+
+namespace bitboard {
+  // One bit per square, square index is 8 * rank + file (a1 = 0, h1 = 7, h8 = 63).
+  // This is the same layout as the zobrist and PST tables.
+  typedef uint64_t bitboard_t;
+
+  const bitboard_t FILE_A = 0x0101010101010101ULL;
+  const bitboard_t FILE_H = FILE_A << 7;
+  const bitboard_t RANK_1 = 0xFFULL;
+  const bitboard_t RANK_8 = RANK_1 << 56;
+
+  // Magic multiply lookup for one square of a sliding piece.
+  struct Magic {
+    bitboard_t mask;
+    bitboard_t magic;
+    bitboard_t *attacks;
+    int shift;
+  };
+
+  // Built at compile time (see bitboard.cpp).
+  extern const bitboard_t KNIGHT_ATTACKS[64];
+  extern const bitboard_t KING_ATTACKS[64];
+  // [isWhite][square] squares attacked by a pawn of that color on square.
+  extern const bitboard_t PAWN_ATTACKS[2][64];
+
+  // Squares strictly between two squares on a shared rank, file or diagonal (else 0).
+  extern const bitboard_t BETWEEN[64][64];
+  // Full rank, file or diagonal through both squares (else 0).
+  extern const bitboard_t LINE[64][64];
+
+  // Filled in once at startup (finding the magics is too slow for constexpr).
+  extern Magic BISHOP_MAGICS[64];
+  extern Magic ROOK_MAGICS[64];
+
+  constexpr int squareIndex(int a, int b) {
+    // a = rank, b = file
+    return 8 * a + b;
+  }
+
+  constexpr bitboard_t squareBit(int square) {
+    return 1ULL << square;
+  }
+
+  inline int popCount(bitboard_t bb) {
+    return __builtin_popcountll(bb);
+  }
+
+  // Undefined for bb == 0.
+  inline int lowestSquare(bitboard_t bb) {
+    return __builtin_ctzll(bb);
+  }
+
+  // Removes and returns the lowest set square, undefined for bb == 0.
+  inline int popLowestSquare(bitboard_t &bb) {
+    int square = __builtin_ctzll(bb);
+    bb &= bb - 1;
+    return square;
+  }
+
+  inline bitboard_t bishopAttacks(int square, bitboard_t occupied) {
+    const Magic &m = BISHOP_MAGICS[square];
+    return m.attacks[((occupied & m.mask) * m.magic) >> m.shift];
+  }
+
+  inline bitboard_t rookAttacks(int square, bitboard_t occupied) {
+    const Magic &m = ROOK_MAGICS[square];
+    return m.attacks[((occupied & m.mask) * m.magic) >> m.shift];
+  }
+
+  inline bitboard_t queenAttacks(int square, bitboard_t occupied) {
+    return bishopAttacks(square, occupied) | rookAttacks(square, occupied);
+  }
+
+  // Walks the rays square by square, used to build and verify the magic tables.
+  bitboard_t bishopAttacks_slow(int square, bitboard_t occupied);
+  bitboard_t rookAttacks_slow(int square, bitboard_t occupied);
+}
+
+#endif // BITBOARD_H
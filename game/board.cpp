@@ -26,16 +26,7 @@ using namespace ttable;
 
 const string Board::PIECE_SYMBOL = "?pnbrqk";
 
-const move_t Board::NULL_MOVE = make_tuple(0, 0, 0, 0, 0, 0, 0);
-
-const map<board_s, movements_t> Board::MOVEMENTS = {
-  {KNIGHT, {{2, 1}, {2, -1}, {-2, 1}, {-2, -1}, {1, 2}, {1, -2}, {-1, 2}, {-1, -2}}},
-  {BISHOP, {{1, 1}, {1, -1}, {-1, 1}, {-1, -1}}},
-  {ROOK, {{1, 0}, {-1, 0}, {0, 1}, {0, -1}}},
-  {QUEEN, {{1, 1}, {1, -1}, {-1, 1}, {-1, -1}, {1, 0}, {-1, 0}, {0, 1}, {0, -1}}},
-  {KING, {{0,-1}, {1,-1}, {1,0}, {1,1}, {0,1}, {-1,1}, {-1,0}, {-1, -1}}},
-};
-
+const move_t Board::NULL_MOVE = 0;
 
 Board::Board(void) {
   resetBoard();
@@ -54,6 +45,8 @@ Board::Board(string fen) {
 
   lastMove = Board::NULL_MOVE;
   memset(&state, '\0', sizeof(state));
+  memset(&pieces, '\0', sizeof(pieces));
+  memset(&colors, '\0', sizeof(colors));
   int y = 7;
   int x = 0;
   int fi;
@@ -96,25 +89,26 @@ Board::Board(string fen) {
     if (castle == 'q') { castleStatus |= BLACK_OOO; }; // blackOOO = true
   }
 
-  // En passant "target square" (square behind the pawn)
+  // En passant "target square" (square behind the pawn that was just pushed two)
   if (parts[3] != "-") {
-    assert( (isWhiteTurn && parts[3][1] == '3') ||
-             (!isWhiteTurn && parts[3][2] == '6') );
+    assert( (isWhiteTurn && parts[3][1] == '6') ||
+            (!isWhiteTurn && parts[3][1] == '3') );
 
     board_s file = parts[3][0] - 'a';
-    board_s rank = parts[3][1] - '0';
-    board_s direction = isWhiteTurn ? 1 : -1;
+    board_s rank = parts[3][1] - '1';
+    // Direction (and color) of the pawn that was pushed.
+    board_s direction = isWhiteTurn ? BLACK : WHITE;
 
     assert( onBoard(rank, file) );
 
-    assert( abs(state[rank + direction][file]) == PAWN );
+    assert( state[rank + direction][file] == direction * PAWN );
     assert( state[rank][file] == 0 );
     assert( state[rank - direction][file] == 0 );
 
-    lastMove = make_tuple(rank - direction, file,
-                          rank + direction, file,
-                          direction * PAWN, 0,
-                          SPECIAL_EN_PASSANT);
+    // The same as makeMove packs a double push.
+    lastMove = packMove(rank - direction, file,
+                        rank + direction, file,
+                        direction * PAWN, 0, 0);
   };
 
   // Number of moves since pawn push or capture.
@@ -134,6 +128,31 @@ Board::Board(string fen) {
 }
 
 
+Board::Board(const board_s squares[64], bool isWhiteTurn, char castleStatus, move_t lastMove) {
+  this->isWhiteTurn = isWhiteTurn;
+  this->castleStatus = castleStatus;
+  this->lastMove = lastMove;
+  halfMoves = 0;
+  gameMoves = !isWhiteTurn;
+
+  memset(&state, '\0', sizeof(state));
+  memset(&pieces, '\0', sizeof(pieces));
+  memset(&colors, '\0', sizeof(colors));
+  for (int square = 0; square < 64; square++) {
+    if (squares[square] != 0) {
+      setSquare(square / 8, square % 8, squares[square]);
+    }
+  }
+
+  material = 0;
+  totalMaterial = 0;
+  position = 0;
+  zobrist = 0;
+  recalculateEvaluations_slow();
+  recalculateZobrist_slow();
+}
+
+
 void Board::resetBoard(void) {
   gameMoves = 0;
   halfMoves = 0;
@@ -142,6 +161,8 @@ void Board::resetBoard(void) {
   castleStatus = WHITE_OO | WHITE_OOO | BLACK_OO | BLACK_OOO;
 
   memset(&state, '\0', sizeof(state));
+  memset(&pieces, '\0', sizeof(pieces));
+  memset(&colors, '\0', sizeof(colors));
 
   lastMove = Board::NULL_MOVE;
 
@@ -253,8 +274,13 @@ string Board::generateFen_slow(void) const {
     rep += " ";
   }
 
-  // TODO en passant.
-  rep += "- ";
+  // En passant target after any double push (like the zobrist).
+  if (abs(movePiece(lastMove)) == PAWN && abs(moveFrom(lastMove) - moveTo(lastMove)) == 16) {
+    int target = (moveFrom(lastMove) + moveTo(lastMove)) / 2;
+    rep += squareName(target / 8, target % 8) + " ";
+  } else {
+    rep += "- ";
+  }
 
   // Half moves clock.
   rep += to_string(halfMoves) + " ";
@@ -275,6 +301,75 @@ bool Board::getIsWhiteTurn(void) const {
 }
 
 
+char Board::getCastleStatus(void) const {
+  return castleStatus;
+}
+
+
+bitboard_t Board::getPieces(board_s absPiece) const {
+  return pieces[absPiece];
+}
+
+
+bitboard_t Board::getColor(bool isWhite) const {
+  return colors[isWhite];
+}
+
+
+bool Board::hasNonPawnMaterial(void) const {
+  bitboard_t nonPawns = pieces[KNIGHT] | pieces[BISHOP] | pieces[ROOK] | pieces[QUEEN];
+  return (nonPawns & colors[isWhiteTurn]) != 0;
+}
+
+
+bool Board::isInCheck(void) const {
+  return (attackersTo(kingSquares[isWhiteTurn], pieces[0]) & colors[!isWhiteTurn]) != 0;
+}
+
+
+bool Board::givesCheck(move_t move) const {
+  int from = moveFrom(move);
+  int to = moveTo(move);
+  board_s moved = abs(movePiece(move));
+  unsigned char special = moveSpecial(move);
+
+  int theirKing = kingSquares[!isWhiteTurn];
+  bitboard_t ours = (colors[isWhiteTurn] & ~squareBit(from)) | squareBit(to);
+  bitboard_t occupied = (pieces[0] & ~squareBit(from)) | squareBit(to);
+  // Our rooks after the move (only differs for castling).
+  bitboard_t rooks = pieces[ROOK];
+
+  if (special == SPECIAL_EN_PASSANT) {
+    // Captured pawn is beside to (on from's rank).
+    occupied &= ~squareBit(8 * (from / 8) + to % 8);
+  } else if (special == SPECIAL_CASTLE) {
+    // King moved two, rook jumps to the square it passed over.
+    bool kingSide = to > from;
+    int rookFrom = kingSide ? from + 3 : from - 4;
+    int rookTo = (from + to) / 2;
+    occupied = (occupied & ~squareBit(rookFrom)) | squareBit(rookTo);
+    ours = (ours & ~squareBit(rookFrom)) | squareBit(rookTo);
+    rooks = (rooks & ~squareBit(rookFrom)) | squareBit(rookTo);
+    // The rook's check is found with the discovered checks below.
+  }
+
+  // Direct check (movePiece is the new piece for promotions).
+  if (moved == PAWN) {
+    if (PAWN_ATTACKS[isWhiteTurn][to] & squareBit(theirKing)) {
+      return true;
+    }
+  } else if (moved != KING && (attacksFrom(moved, to, occupied) & squareBit(theirKing))) {
+    return true;
+  }
+
+  // Discovered check, one of our sliders sees the king now that pieces moved.
+  bitboard_t diagonal = (pieces[BISHOP] | pieces[QUEEN]) & ours & ~squareBit(to);
+  bitboard_t straight = (rooks | pieces[QUEEN]) & ours & ~squareBit(to);
+  return (bishopAttacks(theirKing, occupied) & diagonal) ||
+         (rookAttacks(theirKing, occupied) & straight);
+}
+
+
 board_hash_t Board::getZobrist(void) const {
   return zobrist;
 }
@@ -285,100 +380,252 @@ move_t Board::getLastMove(void) const {
 }
 
 
-vector<Board> Board::getChildrenInternal_slow(void) const {
-  bool hasCapture = false;
-  vector<Board> all_moves;
+MoveList Board::getLegalMoves(void) const {
+  return getLegalMoves(GEN_ALL);
+}
+
+
+MoveList Board::getLegalMoves(unsigned char genType) const {
+  MoveList all_moves;
+
+  // Checkers and pins are found once, every move generated below is legal.
+  int kingSquare = kingSquares[isWhiteTurn];
+  bitboard_t checkers = attackersTo(kingSquare, pieces[0]) & colors[!isWhiteTurn];
+  bitboard_t notSelf = ~colors[isWhiteTurn];
+
+  // Squares the king (and pieces) may land on for this type of generation.
+  bitboard_t typeTargets = ((genType & GEN_CAPTURES) ? colors[!isWhiteTurn] : 0) |
+                           ((genType & GEN_QUIETS) ? ~pieces[0] : 0);
+
+  if (checkers) {
+    // Check evasions: king steps away or (single check) capture / block the checker.
+    addKingMoves(&all_moves, kingSquare, notSelf & typeTargets);
+    if (popCount(checkers) == 1) {
+      int checker = lowestSquare(checkers);
+      addPieceMoves(&all_moves, kingSquare, checkers | BETWEEN[kingSquare][checker], genType);
+    }
+    return all_moves;
+  }
+
+  addPieceMoves(&all_moves, kingSquare, notSelf, genType);
+  addKingMoves(&all_moves, kingSquare, notSelf & typeTargets);
+  if (genType & GEN_QUIETS) {
+    addCastles(&all_moves);
+  }
+  return all_moves;
+}
+
+
+bool Board::isLegalMove(move_t move) const {
+  if (move == NULL_MOVE) {
+    return false;
+  }
+
+  board_s selfColor = isWhiteTurn ? WHITE : BLACK;
+  board_s moving = movePiece(move);
+  board_s capture = moveCapture(move);
+  unsigned char special = moveSpecial(move);
+
+  if (peaceSign(moving) != selfColor) {
+    return false;
+  }
+
+  if (special == SPECIAL_CASTLE || special == SPECIAL_EN_PASSANT) {
+    // Rare, just ask the generator.
+    for (move_t legal : getLegalMoves()) {
+      if (legal == move) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  int from = moveFrom(move);
+  int to = moveTo(move);
+  board_s expected = (special == SPECIAL_PROMOTION) ? selfColor * PAWN : moving;
+  if (state[from / 8][from % 8] != expected || state[to / 8][to % 8] != capture) {
+    return false;
+  }
+  if (capture != 0 && (peaceSign(capture) == selfColor || abs(capture) == KING)) {
+    return false;
+  }
+
+  if (abs(expected) == PAWN) {
+    board_s pawnDirection = isWhiteTurn ? 1 : -1;
+    bool lastRank = (to / 8) == (isWhiteTurn ? 7 : 0);
+    if (lastRank != (special == SPECIAL_PROMOTION)) {
+      return false;
+    }
+    if (lastRank && (abs(moving) < KNIGHT || abs(moving) > QUEEN)) {
+      return false;
+    }
+
+    int push = from + 8 * pawnDirection;
+    if (capture != 0) {
+      if ((PAWN_ATTACKS[isWhiteTurn][from] & squareBit(to)) == 0) {
+        return false;
+      }
+    } else if (to != push) {
+      bool doublePush = (to == push + 8 * pawnDirection) &&
+                        (from / 8 == (isWhiteTurn ? 1 : 6)) &&
+                        (state[push / 8][push % 8] == 0);
+      if (!doublePush) {
+        return false;
+      }
+    }
+  } else if ((attacksFrom(abs(moving), from, pieces[0]) & squareBit(to)) == 0) {
+    return false;
+  }
+
+  return !leavesKingAttacked(move);
+}
+
+
+bitboard_t Board::getPinned(int kingSquare) const {
+  // Their sliders that would see our king on an empty board.
+  bitboard_t snipers = colors[!isWhiteTurn] & (
+      (rookAttacks(kingSquare, 0) & (pieces[ROOK] | pieces[QUEEN])) |
+      (bishopAttacks(kingSquare, 0) & (pieces[BISHOP] | pieces[QUEEN])));
+
+  bitboard_t pinned = 0;
+  while (snipers) {
+    int sniper = popLowestSquare(snipers);
+    bitboard_t blockers = BETWEEN[kingSquare][sniper] & pieces[0];
+    if (popCount(blockers) == 1) {
+      pinned |= blockers & colors[isWhiteTurn];
+    }
+  }
+  return pinned;
+}
+
 
+void Board::addPieceMoves(
+    MoveList *all_moves, int kingSquare, bitboard_t targets, unsigned char genType) const {
   board_s pawnDirection = isWhiteTurn ? 1 : -1;
   board_s selfColor = isWhiteTurn ? WHITE : BLACK;
   board_s oppColor = isWhiteTurn ? BLACK : WHITE;
 
-  pair<bool, board_s> moveTest;
-  for (int y = 0; y < 8; y++) {
-    for (int x = 0; x < 8; x++) {
-      board_s piece = state[y][x];
-      if (piece == 0 || isWhiteTurn != isWhitePiece(piece)) {
-        continue;
+  bitboard_t self = colors[isWhiteTurn];
+  bitboard_t opp = colors[!isWhiteTurn];
+  bitboard_t empty = ~pieces[0];
+  bitboard_t pinned = getPinned(kingSquare);
+
+  bool genCaptures = genType & GEN_CAPTURES;
+  bool genQuiets = genType & GEN_QUIETS;
+  // Promotions are generated with the captures.
+  board_s promoRank = isWhiteTurn ? 7 : 0;
+
+  bitboard_t pawns = pieces[PAWN] & self;
+  while (pawns) {
+    int from = popLowestSquare(pawns);
+    board_s y = from / 8;
+    board_s x = from % 8;
+
+    // Pinned pieces can only move along the pin.
+    bitboard_t allowed = targets;
+    if (pinned & squareBit(from)) {
+      allowed &= LINE[kingSquare][from];
+    }
+
+    // Pawn Capture (plus potential promotion)
+    bitboard_t captures = genCaptures ? PAWN_ATTACKS[isWhiteTurn][from] & opp & allowed : 0;
+    while (captures) {
+      int to = popLowestSquare(captures);
+      promoHelper(all_moves, selfColor, x, y, to % 8, to / 8);
+    }
+
+    // pawn move: if next space is empty.
+    int push = from + 8 * pawnDirection;
+    if (empty & squareBit(push)) {
+      // Normal move forward && promo
+      bool wanted = (y + pawnDirection == promoRank) ? genCaptures : genQuiets;
+      if (wanted && (allowed & squareBit(push))) {
+        promoHelper(all_moves, selfColor, x, y, x, y + pawnDirection);
       }
-      board_s absPiece = abs(piece);
-
-      if (absPiece == PAWN) {
-        // pawn capture
-        for (board_s lr = -1; lr <= 1; lr += 2) {
-          moveTest = attemptMove(y + pawnDirection, x + lr);
-          if (moveTest.first && moveTest.second == oppColor) {
-            // Pawn Capture (plus potential promotion)
-            promoHelper(&all_moves, selfColor, x, y, x + lr, y + pawnDirection);
-            hasCapture = true;
-          }
-        }
 
-        moveTest = attemptMove(y + pawnDirection, x);
-        // pawn move: if next space is empty.
-        if (moveTest.first && moveTest.second == 0) {
-          // Normal move forward && promo
-          promoHelper(&all_moves, selfColor, x, y, x, y + pawnDirection);
-
-          // double move (only if nothing in the way for single move)
-          if ((isWhiteTurn && y == 1) || (!isWhiteTurn && y == 6)) {
-            moveTest = attemptMove(y + 2 * pawnDirection, x);
-            if (moveTest.first && moveTest.second == 0) {
-              Board c = copy();
-              c.makeMove(y,x,    y + 2 * pawnDirection, x);
-              all_moves.push_back( c );
-            }
-          }
-        }
-      } else if (absPiece == KNIGHT || absPiece == KING) {
-        // "jumpy" pieces = KNIGHT, KING
-        for (auto iter = MOVEMENTS.at(absPiece).begin();
-                  iter != MOVEMENTS.at(absPiece).end();
-                  iter++) {
-          moveTest = attemptMove(y + iter->first, x + iter->second);
-          if (moveTest.first && moveTest.second != selfColor) {
-            bool isCapture = moveTest.second != 0;
-            hasCapture |= isCapture;
-
-            Board c = copy();
-            c.makeMove(y,x,   y + iter->first, x + iter->second);
-            all_moves.push_back( c );
-          }
+      // double move (only if nothing in the way for single move)
+      if (genQuiets && ((isWhiteTurn && y == 1) || (!isWhiteTurn && y == 6))) {
+        int doublePush = push + 8 * pawnDirection;
+        if (empty & allowed & squareBit(doublePush)) {
+          all_moves->push_back(packMove(
+              y, x,   y + 2 * pawnDirection, x,   selfColor * PAWN, 0, 0));
         }
-      } else {
-        // slidy pieces = BISHOPS, ROOKS, QUEENS
-        assert( absPiece == BISHOP || absPiece == ROOK || absPiece == QUEEN );
-        for (auto iter = MOVEMENTS.at(absPiece).begin();
-                  iter != MOVEMENTS.at(absPiece).end();
-                  iter++) {
-          board_s deltaY = iter->first;
-          board_s deltaX = iter->second;
-          board_s newY = y;
-          board_s newX = x;
-          while (true) {
-            newY += deltaY;
-            newX += deltaX;
-
-            moveTest = attemptMove(newY, newX);
-
-            if (!moveTest.first || moveTest.second == selfColor) {
-              break;
-            }
-
-            bool isCapture = moveTest.second != 0;
-            hasCapture |= isCapture;
-
-            Board c = copy();
-            c.makeMove(y, x,   newY, newX);
-            all_moves.push_back( c );
-
-            if (moveTest.second == oppColor) {
-              break;
-            }
-          }
+      }
+    }
+  }
+
+  // Non pawns just land on opp pieces (captures) or empty squares (quiets).
+  targets &= (genCaptures ? opp : 0) | (genQuiets ? empty : 0);
+
+  // "jumpy" pieces = KNIGHT and slidy pieces = BISHOPS, ROOKS, QUEENS
+  // A pinned knight can never stay on the pin line.
+  bitboard_t knights = pieces[KNIGHT] & self & ~pinned;
+  while (knights) {
+    int from = popLowestSquare(knights);
+    addMoves(all_moves, from, KNIGHT_ATTACKS[from] & targets);
+  }
+
+  for (board_s absPiece = BISHOP; absPiece <= QUEEN; absPiece++) {
+    bitboard_t movers = pieces[absPiece] & self;
+    while (movers) {
+      int from = popLowestSquare(movers);
+      bitboard_t allowed = targets;
+      if (pinned & squareBit(from)) {
+        allowed &= LINE[kingSquare][from];
+      }
+      addMoves(all_moves, from, attacksFrom(absPiece, from, pieces[0]) & allowed);
+    }
+  }
+
+  // En passant
+  // Pawn moving two spaces forward! (lastMove = (a, b), (c, d) moving, removing)
+  int lastFrom = moveFrom(lastMove);
+  int lastTo = moveTo(lastMove);
+  if (genCaptures && movePiece(lastMove) == oppColor * PAWN && abs(lastFrom - lastTo) == 16) {
+    assert( lastFrom % 8 == lastTo % 8 );
+    // pawn moved to c so en passant can only happen from c - pawnDirection;
+    board_s lastY = lastTo / 8;
+    board_s lastX = lastTo % 8;
+
+    for (board_s lr = -1; lr <= 1; lr += 2) {
+      board_s testX = lastX + lr;
+
+      // Capturing pawn is adjacent after double move.
+      if (0 <= testX && testX <= 7 && state[lastY][testX] == selfColor * PAWN) {
+        // Move our pawn (and record their pawn as captured).
+        move_t move = packMove(
+            lastY, testX,   lastY + pawnDirection, lastX,
+            selfColor * PAWN, oppColor * PAWN, SPECIAL_EN_PASSANT);
+
+        // Two pawns leave the rank at once, rare enough to just test the result.
+        if (!leavesKingAttacked(move)) {
+          all_moves->push_back(move);
         }
       }
     }
   }
+}
+
+
+void Board::addKingMoves(MoveList *all_moves, int kingSquare, bitboard_t targets) const {
+  // Sliders see through the king's current square.
+  bitboard_t occupied = pieces[0] ^ squareBit(kingSquare);
+  board_s king = state[kingSquare / 8][kingSquare % 8];
+
+  bitboard_t moves = KING_ATTACKS[kingSquare] & targets;
+  while (moves) {
+    int to = popLowestSquare(moves);
+    if ((attackersTo(to, occupied) & colors[!isWhiteTurn]) == 0) {
+      all_moves->push_back(packMove(
+          kingSquare / 8, kingSquare % 8,   to / 8, to % 8,
+          king, state[to / 8][to % 8], 0));
+    }
+  }
+}
+
+
+void Board::addCastles(MoveList *all_moves) const {
+  board_s selfColor = isWhiteTurn ? WHITE : BLACK;
 
   int y = isWhiteTurn ? 0 : 7;
   int x = 4;
@@ -390,12 +637,12 @@ vector<Board> Board::getChildrenInternal_slow(void) const {
       // Check empty squares.
       if (state[y][1] == 0 && state[y][2] == 0 && state[y][3] == 0) {
         // chek for attack on [4] [3] and [2]
-        if ((checkAttack_medium(isWhiteTurn, y, 4) == 0) &&
-            (checkAttack_medium(isWhiteTurn, y, 3) == 0) &&
-            (checkAttack_medium(isWhiteTurn, y, 2) == 0)) {
-          Board c = copy();
-          c.makeMove(y, 4,   y, 2, SPECIAL_CASTLE); // Record king over two as the move.
-          all_moves.push_back( c );
+        if ((checkAttack(isWhiteTurn, y, 4) == 0) &&
+            (checkAttack(isWhiteTurn, y, 3) == 0) &&
+            (checkAttack(isWhiteTurn, y, 2) == 0)) {
+          // Record king over two as the move.
+          all_moves->push_back(packMove(
+              y, 4,   y, 2,   selfColor * KING, 0, SPECIAL_CASTLE));
         }
       }
     }
@@ -403,99 +650,68 @@ vector<Board> Board::getChildrenInternal_slow(void) const {
       // Check empty squares.
       if (state[y][5] == 0 && state[y][6] == 0) {
         // chek for attack on [4] [5] and [6]
-        if ((checkAttack_medium(isWhiteTurn, y, 4) == 0) &&
-            (checkAttack_medium(isWhiteTurn, y, 5) == 0) &&
-            (checkAttack_medium(isWhiteTurn, y, 6) == 0)) {
-          Board c = copy();
-          c.makeMove(y, 4,   y, 6, SPECIAL_CASTLE); // Record king over two as the move.
-          all_moves.push_back( c );
+        if ((checkAttack(isWhiteTurn, y, 4) == 0) &&
+            (checkAttack(isWhiteTurn, y, 5) == 0) &&
+            (checkAttack(isWhiteTurn, y, 6) == 0)) {
+          // Record king over two as the move.
+          all_moves->push_back(packMove(
+              y, 4,   y, 6,   selfColor * KING, 0, SPECIAL_CASTLE));
         }
       }
       // Have to check for attack and empty squares.
     }
   }
+}
 
-  // En passant
-  // Pawn moving two spaces forward! (lastMove = (a, b), (c, d) moving, removing)
-  if (get<4>(lastMove) == oppColor * PAWN && abs(get<0>(lastMove) - get<2>(lastMove)) == 2) {
-    assert( get<1>(lastMove) == get<3>(lastMove) );
-    // pawn moved to c so en passant can only happen from c - pawnDirection;
-    board_s lastY = get<2>(lastMove);
-    board_s lastX = get<3>(lastMove);
-
-    for (board_s lr = -1; lr <= 1; lr += 2) {
-      board_s testX = lastX + lr;
 
-      // Capturing pawn is adjacent after double move.
-      if (0 <= testX && testX <= 7 && state[lastY][testX] == selfColor * PAWN) {
-        Board c = copy();
-        // Move our pawn
-        c.makeMove(lastY, testX, lastY + pawnDirection, lastX, SPECIAL_EN_PASSANT);
-        all_moves.push_back( c );
-      }
-    }
-  }
-  return all_moves;
-}
+bool Board::leavesKingAttacked(move_t move) const {
+  unsigned char special = moveSpecial(move);
+  assert( special != SPECIAL_CASTLE );
 
+  int from = moveFrom(move);
+  int to = moveTo(move);
 
-vector<Board> Board::getLegalChildren(void) const {
-  vector<Board> all_moves = getChildrenInternal_slow();
-  if (all_moves.size() == 0) {
-    return all_moves;
+  // Occupancy and captured piece after the move, without making it.
+  bitboard_t captured = squareBit(to);
+  if (special == SPECIAL_EN_PASSANT) {
+    captured = squareBit(squareIndex(from / 8, to % 8));
   }
+  bitboard_t occupied = (pieces[0] & ~squareBit(from) & ~captured) | squareBit(to);
 
-  board_s selfColor = isWhiteTurn ? WHITE : BLACK;
-  board_s selfKing = selfColor * KING;
-  // A guess where king will be (or nearby).
-  board_s kingY = -1;
-  board_s kingX;
-
-  for (int y = 0; kingY == -1 && y < 8; y++) {
-    for (int x = 0; x < 8; x++) {
-      board_s piece = state[y][x];
-      if (piece == selfKing) {
-        kingY = y;
-        kingX = x;
-        break;
-      }
-    }
-  }
+  int kingSquare = (abs(movePiece(move)) == KING) ?
+      to : kingSquares[isWhiteTurn];
 
-  assert( onBoard(kingY, kingX) );
+  bitboard_t attackers = attackersTo(kingSquare, occupied) & colors[!isWhiteTurn] & ~captured;
+  return attackers != 0;
+}
 
-  // TODO lots of optimizations
-  //    was square under double attack => had to move
-  //    was square under knight attack => had to destroy knight or move
-  //    was attack from adjacent square => had to move or destroy
-  //    was square under slide attack =>
-  //      if king didn't move
-  //        last move must be in way of single attack.
 
-  for (auto test = all_moves.begin(); test != all_moves.end(); test++) {
-    board_s testY = kingY;
-    board_s testX = kingX;
+vector<Board> Board::getLegalChildren(void) const {
+  vector<Board> children;
+  for (move_t move : getLegalMoves()) {
+    Board c = copy();
+    c.makeMove(move);
+    children.push_back(c);
+  }
+  return children;
+}
 
-    // Check if king is still in same place.
-    if (test->state[kingY][kingX] != selfKing) {
-      // king must have moved (lookup where it went).
-      testY = get<2>(test->getLastMove());
-      testX = get<3>(test->getLastMove());
-      assert( onBoard(testY, testX) );
-    }
 
-    assert( test->state[testY][testX] == selfKing );
-    if (test->checkAttack_medium(isWhiteTurn, testY, testX) != 0) {
-      all_moves.erase(test);
-      test--;
-    }
+void Board::addMoves(MoveList *all_moves, int from, bitboard_t targets) const {
+  board_s a = from / 8;
+  board_s b = from % 8;
+  board_s moving = state[a][b];
+  while (targets) {
+    int to = popLowestSquare(targets);
+    board_s c = to / 8;
+    board_s d = to % 8;
+    all_moves->push_back(packMove(a, b,   c, d,   moving, state[c][d], 0));
   }
-  return all_moves;
 }
 
 
 void Board::promoHelper(
-  vector<Board> *all_moves,
+  MoveList *all_moves,
   board_s selfColor,
   board_s x,
   board_s y,
@@ -503,150 +719,151 @@ void Board::promoHelper(
   board_s y2) const {
 
   assert(state[y][x] == selfColor * PAWN);
+  board_s removed = state[y2][x2];
   if ((isWhiteTurn && y2 == 7) || (!isWhiteTurn && y2 == 0)) {
-    board_s movingPawn = state[y][x];
     // promotion && underpromotion
     board_s lastPromoPiece = QUEEN;
     for (board_s newPiece = lastPromoPiece; newPiece >= KNIGHT; newPiece--) {
       // "promote" then move piece (this means history shows Queen moving to back row not a pawn)
-      Board c = copy();
-
-      // We replace the pawn with a newPiece.
-      board_s signedPiece = selfColor * newPiece;
-      c.state[y][x] = signedPiece;
-
-      c.updatePiece(y, x, movingPawn, false /* movingTo */);
-      c.updatePiece(y, x, signedPiece, true /* movingTo */);
-
-      c.makeMove(y,x,    y2, x2, SPECIAL_PROMOTION);
-
-      all_moves->push_back(c);
+      all_moves->push_back(packMove(
+          y, x,   y2, x2,   selfColor * newPiece, removed, SPECIAL_PROMOTION));
     }
   } else {
     // Normal move to square.
-    Board c = copy();
-    c.makeMove(y,x,    y2, x2);
-    all_moves->push_back(c);
+    all_moves->push_back(packMove(y, x,   y2, x2,   selfColor * PAWN, removed, 0));
   }
 }
 
 
-board_s Board::checkAttack_medium(bool byBlack, board_s a, board_s b) const {
-  board_s selfColor = byBlack ? WHITE : BLACK;
-  board_s oppKnight = byBlack ? -KNIGHT: KNIGHT;
-  board_s selfPawnDirection = byBlack ? 1 : -1;
-
-  // Check if knight is attacking square.
-  for (auto iter = MOVEMENTS.at(KNIGHT).begin();
-            iter != MOVEMENTS.at(KNIGHT).end();
-            iter++) {
-    board_s attackingKnight = getPiece(a + iter->first, b + iter->second);
-    if (attackingKnight ==  oppKnight) {
-      return attackingKnight;
-    }
+board_s Board::checkAttack(bool byBlack, board_s a, board_s b) const {
+  bitboard_t attackers = attackersTo(squareIndex(a, b), pieces[0]) & colors[!byBlack];
+  if (attackers == 0) {
+    return 0;
   }
 
-  pair<bool, board_s> moveTest;
-  // check if slidy piece is attacking square.
-  for (auto iter = MOVEMENTS.at(QUEEN).begin();
-            iter != MOVEMENTS.at(QUEEN).end();
-            iter++) {
-    board_s deltaY = iter->first;
-    board_s deltaX = iter->second;
-    board_s newY = a;
-    board_s newX = b;
-    while (true) {
-      newY += deltaY;
-      newX += deltaX;
-
-      moveTest = attemptMove(newY, newX);
-      if (!moveTest.first || moveTest.second == selfColor) {
-        break;
-      }
+  int attacker = lowestSquare(attackers);
+  return state[attacker / 8][attacker % 8];
+}
 
-      if (moveTest.second != 0) {
-        const board_s oppPiece = state[newY][newX];
-        const board_s pieceType = abs(oppPiece);
-        // check if oppPiece can deliver this type of attack
-        if (pieceType == QUEEN) {
-          return oppPiece;
-        }
 
-        board_s distance = abs(a - newY) + abs(b - newX);
-
-        bool isStraight = iter->first == 0 || iter->second == 0;
-        if (isStraight) {
-          if (distance == 1 && pieceType == KING) {
-            return oppPiece;
-          }
-          if (pieceType == ROOK) {
-            return oppPiece;
-          }
-          break;
-        }
+int Board::staticExchange(move_t move) const {
+  int from = moveFrom(move);
+  int to = moveTo(move);
+  unsigned char special = moveSpecial(move);
 
-        bool isDiagonal = iter->first != 0 && iter->second != 0;
-        assert( isDiagonal );
+  // gain[d] = what the side capturing at depth d has won if the exchange stops after it.
+  int gain[32];
+  int d = 0;
 
-        if (pieceType == BISHOP) {
-          return oppPiece;
-        }
+  bitboard_t occupied = pieces[0] ^ squareBit(from);
+  board_s captured = moveCapture(move);
+  gain[0] = captured ? PST_PIECE_VALUE[abs(captured)] : 0;
 
-        if (distance == 2) {
-          // KING or PAWN might be attacker
-          if (pieceType == KING) {
-            return oppPiece;
-          }
+  // Value of the piece on to (which the next capture would take).
+  int onSquare = PST_PIECE_VALUE[abs(movePiece(move))];
+  if (special == SPECIAL_PROMOTION) {
+    gain[0] += onSquare - PST_PIECE_VALUE[PAWN];
+  }
+  if (special == SPECIAL_EN_PASSANT) {
+    // The captured pawn is beside from (not on to).
+    occupied ^= squareBit(squareIndex(from / 8, to % 8));
+  }
 
-          // vector from king to piece so inverted pawn direction.
-          if (deltaY == selfPawnDirection && pieceType == PAWN) {
-            return oppPiece;
-          }
-        }
+  bitboard_t diagonal = pieces[BISHOP] | pieces[QUEEN];
+  bitboard_t straight = pieces[ROOK] | pieces[QUEEN];
+  bitboard_t attackers = attackersTo(to, occupied) & occupied;
+  bool side = !isWhiteTurn;
+
+  while (true) {
+    d++;
+    assert( d < 32 );
+    gain[d] = onSquare - gain[d - 1];
+    // Neither side would continue (standing pat is better either way).
+    if (max(-gain[d - 1], gain[d]) < 0) {
+      break;
+    }
 
-        // Hit a piece, nothing does x-ray.
-        break;
-      }
+    bitboard_t ours = attackers & colors[side];
+    if (!ours) {
+      break;
+    }
+
+    // Least valuable attacker.
+    board_s piece = PAWN;
+    while (!(ours & pieces[piece])) {
+      piece++;
     }
-  }
-  return 0;
-}
 
+    // King can only capture the last defender.
+    if (piece == KING && (attackers & colors[!side])) {
+      break;
+    }
 
-pair<bool, board_s> Board::attemptMove(board_s a, board_s b) const {
-  // prep for moving piece to state[a][b]
-  // returns on board, piece on [a][b]
+    occupied ^= squareBit(lowestSquare(ours & pieces[piece]));
+    onSquare = PST_PIECE_VALUE[piece];
 
-  if (onBoard(a, b)) {
-    board_s destPiece = state[a][b];
-    if (destPiece) {
-      return make_pair(true, peaceSign(destPiece));
+    // Sliders behind the piece that just captured (x-rays).
+    if (piece == PAWN || piece == BISHOP || piece == QUEEN) {
+      attackers |= bishopAttacks(to, occupied) & diagonal;
     }
-    return make_pair(true, 0);
+    if (piece == ROOK || piece == QUEEN) {
+      attackers |= rookAttacks(to, occupied) & straight;
+    }
+    attackers &= occupied;
+    side = !side;
+  }
+
+  // The last gain was never taken (no capture or not worth it), negamax the rest back.
+  while (--d) {
+    gain[d - 1] = -max(-gain[d - 1], gain[d]);
   }
-  return make_pair(false, 0);
+  return gain[0];
 }
 
 
-board_s Board::getPiece(board_s a, board_s b) const {
-  return onBoard(a, b) ? state[a][b] : 0;
+bitboard_t Board::attackersTo(int square, bitboard_t occupied) const {
+  // A pawn attacks square if a pawn of the other color on square would attack it.
+  return (PAWN_ATTACKS[false][square] & pieces[PAWN] & colors[true]) |
+         (PAWN_ATTACKS[true][square] & pieces[PAWN] & colors[false]) |
+         (KNIGHT_ATTACKS[square] & pieces[KNIGHT]) |
+         (KING_ATTACKS[square] & pieces[KING]) |
+         (bishopAttacks(square, occupied) & (pieces[BISHOP] | pieces[QUEEN])) |
+         (rookAttacks(square, occupied) & (pieces[ROOK] | pieces[QUEEN]));
+}
+
+
+bitboard_t Board::attacksFrom(board_s absPiece, int square, bitboard_t occupied) const {
+  if (absPiece == KNIGHT) {
+    return KNIGHT_ATTACKS[square];
+  } else if (absPiece == BISHOP) {
+    return bishopAttacks(square, occupied);
+  } else if (absPiece == ROOK) {
+    return rookAttacks(square, occupied);
+  } else if (absPiece == QUEEN) {
+    return queenAttacks(square, occupied);
+  } else if (absPiece == KING) {
+    return KING_ATTACKS[square];
+  }
+
+  assert( false );
+  return 0;
 }
 
 
 void Board::makeMove(move_t move) {
-  board_s a = get<0>(move);
-  board_s b = get<1>(move);
-  board_s c = get<2>(move);
-  board_s d = get<3>(move);
-  unsigned char special = get<6>(move);
+  board_s a = moveFrom(move) / 8;
+  board_s b = moveFrom(move) % 8;
+  board_s c = moveTo(move) / 8;
+  board_s d = moveTo(move) % 8;
+  unsigned char special = moveSpecial(move);
 
   if (special != SPECIAL_EN_PASSANT) {
-    board_s capture = get<5>(move);
+    board_s capture = moveCapture(move);
     assert (state[c][d] == capture);
   }
 
   if (special == SPECIAL_PROMOTION) {
-    board_s moving  = get<4>(move);
+    board_s moving  = movePiece(move);
     board_s disappearingPawn = peaceSign(moving) * PAWN;
     assert(state[a][b] ==  disappearingPawn);
     state[a][b] = moving;
@@ -661,6 +878,116 @@ void Board::makeMove(move_t move) {
 }
 
 
+void Board::makeMove(move_t move, UndoState *undo) {
+  undo->material = material;
+  undo->totalMaterial = totalMaterial;
+  undo->position = position;
+  undo->zobrist = zobrist;
+  undo->lastMove = lastMove;
+  undo->halfMoves = halfMoves;
+  undo->castleStatus = castleStatus;
+
+  makeMove(move);
+}
+
+
+void Board::unmakeMove(move_t move, const UndoState &undo) {
+  board_s a = moveFrom(move) / 8;
+  board_s b = moveFrom(move) % 8;
+  board_s c = moveTo(move) / 8;
+  board_s d = moveTo(move) % 8;
+  board_s moving = movePiece(move);
+  board_s removed = moveCapture(move);
+  unsigned char special = moveSpecial(move);
+
+  assert(state[c][d] == moving);
+
+  // Only pieces move back, all the evaluation and hash state comes from undo.
+  if (special == SPECIAL_EN_PASSANT) {
+    setSquare(c, d, 0);
+    setSquare(a, d, removed);
+  } else {
+    setSquare(c, d, removed);
+  }
+
+  setSquare(a, b, (special == SPECIAL_PROMOTION) ? peaceSign(moving) * PAWN : moving);
+
+  if (special == SPECIAL_CASTLE) {
+    board_s ourRook = peaceSign(moving) * ROOK;
+    if (d == 2) {
+      setSquare(a, 3, 0);
+      setSquare(a, 0, ourRook);
+    } else {
+      setSquare(a, 5, 0);
+      setSquare(a, 7, ourRook);
+    }
+  }
+
+  gameMoves--;
+  isWhiteTurn = !isWhiteTurn;
+
+  material = undo.material;
+  totalMaterial = undo.totalMaterial;
+  position = undo.position;
+  zobrist = undo.zobrist;
+  lastMove = undo.lastMove;
+  halfMoves = undo.halfMoves;
+  castleStatus = undo.castleStatus;
+}
+
+
+void Board::makeNullMove(UndoState *undo) {
+  undo->material = material;
+  undo->totalMaterial = totalMaterial;
+  undo->position = position;
+  undo->zobrist = zobrist;
+  undo->lastMove = lastMove;
+  undo->halfMoves = halfMoves;
+  undo->castleStatus = castleStatus;
+
+  gameMoves++;
+  halfMoves++;
+  isWhiteTurn = !isWhiteTurn;
+  updateZobristTurn(true); //Toggle turn.
+  updateZobristEnPassant(lastMove); // Toggle off last move.
+
+  lastMove = NULL_MOVE;
+}
+
+
+void Board::unmakeNullMove(const UndoState &undo) {
+  gameMoves--;
+  isWhiteTurn = !isWhiteTurn;
+
+  zobrist = undo.zobrist;
+  lastMove = undo.lastMove;
+  halfMoves = undo.halfMoves;
+}
+
+
+void Board::setSquare(board_s a, board_s b, board_s piece) {
+  bitboard_t bit = squareBit(squareIndex(a, b));
+
+  board_s old = state[a][b];
+  if (old != 0) {
+    pieces[0] ^= bit;
+    pieces[abs(old)] ^= bit;
+    colors[isWhitePiece(old)] ^= bit;
+  }
+
+  if (piece != 0) {
+    pieces[0] ^= bit;
+    pieces[abs(piece)] ^= bit;
+    colors[isWhitePiece(piece)] ^= bit;
+    if (abs(piece) == KING) {
+      kingSquares[isWhitePiece(piece)] = squareIndex(a, b);
+    }
+  }
+
+  state[a][b] = piece;
+}
+
+
 void Board::makeMove(board_s a, board_s b, board_s c, board_s d, unsigned char special) {
   if (special == SPECIAL_CASTLE) {
     board_s ourKing = state[a][4];
@@ -686,7 +1013,7 @@ void Board::makeMove(board_s a, board_s b, board_s c, board_s d, unsigned char s
   }
 
   makeMove(a, b, c, d);
-  get<6>(lastMove) = special;
+  lastMove |= special << 20;
 
   if (special == SPECIAL_EN_PASSANT) {
     board_s theirPawn = state[a][d];
@@ -694,7 +1021,7 @@ void Board::makeMove(board_s a, board_s b, board_s c, board_s d, unsigned char s
 
     state[a][d] = 0;
     // Note that we captured a pawn.
-    get<5>(lastMove) = theirPawn;
+    lastMove = packMove(a, b, c, d, movePiece(lastMove), theirPawn, special);
     updatePiece(a, d, theirPawn, false /* movingTo */);
     halfMoves = 0;
   }
@@ -776,7 +1103,7 @@ void Board::makeMove(board_s a, board_s b, board_s c, board_s d) {
   updateZobristTurn(true); //Toggle turn.
   updateZobristEnPassant(lastMove); // Toggle off last move.
 
-  lastMove = make_tuple(a, b, c, d, moving, removed, 0);
+  lastMove = packMove(a, b, c, d, moving, removed, 0);
   updateZobristEnPassant(lastMove); // Toggle on this move.
 
   if (removed != 0) {
@@ -793,9 +1120,9 @@ bool Board::makeAlgebraicMove_slow(string move) {
   // This is like slow^2.
   // For each child, go another lookup over each child (to find if it's disambigous)
 
-  for (Board c : getLegalChildren()) {
-    if (algebraicNotation_slow(c.getLastMove()) == move) {
-      makeMove(c.getLastMove());
+  for (move_t legal : getLegalMoves()) {
+    if (algebraicNotation_slow(legal) == move) {
+      makeMove(legal);
       return true;
     }
   }
@@ -820,19 +1147,16 @@ string Board::algebraicNotation_slow(move_t child_move) const {
   child_board.makeMove(child_move);
 
   // NOTE(seth): It appears disambigous is only looking at "valid" moves.
-  vector<Board> children = getLegalChildren();
-  for (Board c : children) {
+  for (move_t legal : getLegalMoves()) {
     // same piece, same destination, same special.
-    if ((get<2>(child_move) == get<2>(c.lastMove)) &&
-        (get<3>(child_move) == get<3>(c.lastMove)) &&
-        (get<4>(child_move) == get<4>(c.lastMove)) &&
-        (get<6>(child_move) == get<6>(c.lastMove))) {
-      bool equalFile = get<1>(child_move) == get<1>(c.lastMove);
-      bool equalRank = get<0>(child_move) == get<0>(c.lastMove);
+    if ((moveTo(child_move) == moveTo(legal)) &&
+        (movePiece(child_move) == movePiece(legal)) &&
+        (moveSpecial(child_move) == moveSpecial(legal))) {
+      bool equalFile = moveFrom(child_move) % 8 == moveFrom(legal) % 8;
+      bool equalRank = moveFrom(child_move) / 8 == moveFrom(legal) / 8;
 
       if (equalFile && equalRank) {
         // the move itself.
-        assert(c.getZobrist() == child_board.getZobrist());
         continue;
       }
       mult = true;
@@ -843,16 +1167,9 @@ string Board::algebraicNotation_slow(move_t child_move) const {
 
 
   bool isCheck, isMate;
-  pair<board_s, board_s> oppKingPos =
-      child_board.findPiece_slow(isWhiteTurn ? -KING : KING);
-  assert( child_board.onBoard(get<0>(oppKingPos), get<1>(oppKingPos)) );
-
   // Assume We are currently white.
   // After our move check if blackKing is under attack by white (not byBlack).
-  isCheck = child_board.checkAttack_medium(
-      !isWhiteTurn /* byBlack */,
-      get<0>(oppKingPos),
-      get<1>(oppKingPos)) != 0;
+  isCheck = child_board.isInCheck();
 
   // Note assumes self move can't result in mate.
   isMate = isCheck &&
@@ -861,38 +1178,40 @@ string Board::algebraicNotation_slow(move_t child_move) const {
 
   string check = isMate ? "#" : (isCheck ? "+" : "");
 
-  string capture = get<5>(child_move) == 0 ? "" : "x";
+  string capture = moveCapture(child_move) == 0 ? "" : "x";
 
-  board_s piece = abs(get<4>(child_move));
+  board_s piece = abs(movePiece(child_move));
   string pieceName = string(1, toupper(PIECE_SYMBOL[piece]));
   if (piece == PAWN) {
     pieceName = "";
   }
 
-  string dest = squareName(get<2>(child_move), get<3>(child_move));
+  board_s fromFile = moveFrom(child_move) % 8;
+  board_s fromRank = moveFrom(child_move) / 8;
+  string dest = squareName(moveTo(child_move) / 8, moveTo(child_move) % 8);
 
   bool fileDisambigs = mult && (!sameFile || sameFile && sameRank);
-  string disambiguate = (fileDisambigs ? fileName(get<1>(child_move)) : "") +
-                        (sameFile      ? rankName(get<0>(child_move)) : "");
+  string disambiguate = (fileDisambigs ? fileName(fromFile) : "") +
+                        (sameFile      ? rankName(fromRank) : "");
 
-  unsigned char special = get<6>(child_move);
+  unsigned char special = moveSpecial(child_move);
   if (special == SPECIAL_PROMOTION) {
     // Piece handly records what we promoted to!
     // But it's not a recorded as a pawn move so add capture logic again.
     if (capture.size() > 0) {
-      return fileName(get<1>(child_move)) + capture + dest +  "=" + pieceName + check;
+      return fileName(fromFile) + capture + dest +  "=" + pieceName + check;
     }
     return dest + "=" + pieceName + check;
   }
   if (special == SPECIAL_CASTLE) {
-    return ((get<3>(child_move) == 2) ? "O-O-O" : "O-O") + check;
+    return ((moveTo(child_move) % 8 == 2) ? "O-O-O" : "O-O") + check;
   }
 
   // Pawn captures get file added.
   if (piece == PAWN && capture.size() > 0) {
     // A special (generic) case of disambiguate.
     // Can't be disambigous once we know file.
-    pieceName = fileName(get<1>(child_move));
+    pieceName = fileName(fromFile);
     return pieceName + capture + dest + check;
   }
 
@@ -909,11 +1228,11 @@ string Board::coordinateNotation(move_t move) {
   // This partially (via inference) supports castling, ep
   // and has explicit promotion.
 
-  string fromTo = squareName(get<0>(move), get<1>(move)) + " - " +
-                  squareName(get<2>(move), get<3>(move));
+  string fromTo = squareName(moveFrom(move) / 8, moveFrom(move) % 8) + " - " +
+                  squareName(moveTo(move) / 8, moveTo(move) % 8);
 
-  if (get<6>(move) == SPECIAL_PROMOTION) {
-    string promotedTo = string(1, toupper(PIECE_SYMBOL[abs(get<4>(move))]));
+  if (moveSpecial(move) == SPECIAL_PROMOTION) {
+    string promotedTo = string(1, toupper(PIECE_SYMBOL[abs(movePiece(move))]));
     return fromTo + "(" + promotedTo + ")";
   }
   return fromTo;
@@ -1018,6 +1337,15 @@ void Board::updatePiece(board_s a, board_s b, board_s piece, bool movingTo) {
   int pst = getPSTValue(a, b, piece);
   position += mult * pst;
 
+  // Toggle the square (moving a piece onto a capture toggles occupied twice).
+  bitboard_t bit = squareBit(squareIndex(a, b));
+  pieces[0] ^= bit;
+  pieces[abs(piece)] ^= bit;
+  colors[isWhitePiece(piece)] ^= bit;
+  if (abs(piece) == KING && movingTo) {
+    kingSquares[isWhitePiece(piece)] = squareIndex(a, b);
+  }
+
   updateZobristPiece(a, b, piece);
 }
 
@@ -1027,10 +1355,15 @@ void Board::recalculateEvaluations_slow(void) {
   int oldTotalMaterial = totalMaterial;
   int oldPosition = position;
   board_hash_t oldZobrist = zobrist;
+  bitboard_t oldOccupied = pieces[0];
+  bitboard_t oldWhite = colors[true];
 
   material = 0;
   totalMaterial = 0;
   position = 0;
+  memset(&pieces, '\0', sizeof(pieces));
+  memset(&colors, '\0', sizeof(colors));
+  kingSquares[false] = kingSquares[true] = -1;
   for (int r = 0; r < 8; r++) {
     for (int c = 0; c < 8; c++) {
       board_s piece = state[r][c];
@@ -1046,6 +1379,8 @@ void Board::recalculateEvaluations_slow(void) {
   assert( oldMaterial == 0      | oldMaterial == material           );
   assert( oldTotalMaterial == 0 | oldTotalMaterial == totalMaterial );
   assert( oldPosition == 0      | oldPosition == position           );
+  assert( oldOccupied == 0      | oldOccupied == pieces[0]          );
+  assert( oldWhite == 0         | oldWhite == colors[true]          );
   assert( oldZobrist == zobrist );
 }
 
@@ -1071,11 +1406,11 @@ void Board::updateZobristCastle(char castleStatus) {
 }
 
 
-void Board::updateZobristEnPassant(move_t &move) {
+void Board::updateZobristEnPassant(move_t move) {
   // We don't follow the Polyglot standard and choose to always include the
   // enpassant after a double pawn push.
-  if (abs(get<4>(move)) == PAWN && abs(get<0>(move) - get<2>(move)) == 2) {
-    zobrist ^= POLYGLOT_RANDOM[772 + get<1>(move)];
+  if (abs(movePiece(move)) == PAWN && abs(moveFrom(move) - moveTo(move)) == 16) {
+    zobrist ^= POLYGLOT_RANDOM[772 + moveFrom(move) % 8];
   }
 }
 
@@ -1114,34 +1449,14 @@ int Board::heuristic() const {
 }
 
 
-pair<board_s, board_s> Board::findPiece_slow(board_s piece) const {
-  for (int y = 0; y < 8; y++) {
-    for (int x = 0; x < 8; x++) {
-      if (state[y][x] == piece) {
-        return make_pair(y, x);
-      }
-    }
-  }
-  return make_pair(-1, -1);
-}
-
-
 board_s Board::getGameResult_slow(void) const {
   // TODO: Add 50 move rule and repeated position.
   // TODO: cache gameresult from heuristic and here.
 
-  pair<board_s, board_s> kingPos =
-      findPiece_slow(isWhiteTurn ? KING : -KING);
-  assert( onBoard(get<0>(kingPos), get<1>(kingPos)) );
-
-  bool inCheck = checkAttack_medium(
-      isWhiteTurn /* byBlack */,
-      get<0>(kingPos),
-      get<1>(kingPos)) != 0;
+  bool inCheck = isInCheck();
 
   // This could be improved (maybe making this _medium) by instead checking move_exists?
-  vector<Board> children = getLegalChildren();
-  bool hasChildren = !children.empty();
+  bool hasChildren = !getLegalMoves().empty();
 
   if (hasChildren) {
       // TODO check for draw conditions (insufficent material, ...)
@@ -2,15 +2,18 @@
 #define BOARD_H
 
 #include <atomic>
+#include <cassert>
 #include <map>
 #include <string>
 #include <tuple>
 #include <utility>
 #include <vector>
 
+#include "bitboard.h"
 #include "flags.h"
 
 using namespace std;
+using namespace bitboard;
 
 
 namespace board {
@@ -20,18 +23,91 @@ namespace board {
   typedef uint64_t board_hash_t;
 
   // (a, b) to (c, d), piece that moving, piece that was captured removing, special_status
-  typedef tuple<board_s, board_s, board_s, board_s, board_s, board_s, unsigned char> move_t;
+  // Packed as from square (bits 0-5), to square (6-11), signed moving piece (12-15),
+  // signed captured piece (16-19) and special (20-21), see packMove.
+  typedef uint32_t move_t;
+
+  inline move_t packMove(
+      board_s a, board_s b, board_s c, board_s d,
+      board_s moving, board_s captured, unsigned char special) {
+    return (8 * a + b) | ((8 * c + d) << 6) |
+           ((moving & 0xF) << 12) | ((captured & 0xF) << 16) | (special << 20);
+  }
+
+  // Square index (8 * rank + file) the piece moved from.
+  inline int moveFrom(move_t move) {
+    return move & 63;
+  }
+
+  inline int moveTo(move_t move) {
+    return (move >> 6) & 63;
+  }
+
+  // Signed piece (the promoted piece for promotions).
+  inline board_s movePiece(move_t move) {
+    return (((move >> 12) & 0xF) ^ 8) - 8;
+  }
+
+  // Signed piece captured (0 if none).
+  inline board_s moveCapture(move_t move) {
+    return (((move >> 16) & 0xF) ^ 8) - 8;
+  }
+
+  inline unsigned char moveSpecial(move_t move) {
+    return (move >> 20) & 3;
+  }
+
+  // Fixed capacity generator output, no legal position has more than 218 moves.
+  struct MoveList {
+    static const int MAX_MOVES = 256;
+
+    move_t moves[MAX_MOVES];
+    int count;
+
+    MoveList() : count(0) {}
+
+    void push_back(move_t move) {
+      assert( count < MAX_MOVES );
+      moves[count++] = move;
+    }
+
+    int size(void) const { return count; }
+    bool empty(void) const { return count == 0; }
+
+    move_t& operator[](int i) { return moves[i]; }
+    const move_t& operator[](int i) const { return moves[i]; }
+
+    move_t* begin(void) { return moves; }
+    move_t* end(void) { return moves + count; }
+    const move_t* begin(void) const { return moves; }
+    const move_t* end(void) const { return moves + count; }
+  };
 
   struct FindMoveStats {
     int plyR;
+    // Includes quiesceNodes.
     int nodes;
+    int quiesceNodes;
+    // Aspiration window failures that had to be searched again.
+    int researches;
+    // Principal variation (expected line of play) from the root.
+    vector<move_t> pv;
+  };
+
+  // Everything makeMove changes that unmakeMove can't recover from the move itself.
+  struct UndoState {
+    int material;
+    int totalMaterial;
+    int position;
+    board_hash_t zobrist;
+    move_t lastMove;
+    short halfMoves;
+    char castleStatus;
   };
 
   // score concatonated to end of move_t
   typedef pair<int, move_t> scored_move_t;
 
-  typedef vector<pair<board_s, board_s>> movements_t;
-
   typedef board_s board_t[8][8];
 
 
@@ -62,6 +138,11 @@ namespace board {
       static const unsigned char SPECIAL_EN_PASSANT = 2;
       static const unsigned char SPECIAL_PROMOTION = 3;
 
+      // Move generation types (captures include en passant and all promotions).
+      static const unsigned char GEN_CAPTURES = 1;
+      static const unsigned char GEN_QUIETS   = 2;
+      static const unsigned char GEN_ALL      = 3;
+
       // Game result
       static const board_s RESULT_IN_PROGRESS = 100;
       static const board_s RESULT_TIE         = 101;
@@ -74,11 +155,13 @@ namespace board {
 
       static const move_t NULL_MOVE;
       static const string PIECE_SYMBOL;
-      static const map<board_s, movements_t> MOVEMENTS;
 
       // Constructors
       Board(void);
       Board(string fen);
+      // squares[8 * rank + file] is the (signed) piece there, move counters start at zero.
+      // Only a double pawn push lastMove matters (for en passant).
+      Board(const board_s squares[64], bool isWhiteTurn, char castleStatus, move_t lastMove);
 
       void resetBoard(void);
 
@@ -89,12 +172,31 @@ namespace board {
       void printBoard(void) const;
 
       bool getIsWhiteTurn(void) const;
+      char getCastleStatus(void) const;
+      // Squares with absPiece (of either color), getPieces(0) is all occupied squares.
+      bitboard_t getPieces(board_s absPiece) const;
+      bitboard_t getColor(bool isWhite) const;
+      bool isInCheck(void) const;
+      // Would legal move put the other side in check (without making it).
+      bool givesCheck(move_t move) const;
+      // Side to move has a knight, bishop, rook or queen.
+      bool hasNonPawnMaterial(void) const;
       board_hash_t getZobrist(void) const;
 
       move_t getLastMove(void) const;
+      MoveList getLegalMoves(void) const;
+      MoveList getLegalMoves(unsigned char genType) const;
+      // Is move (say from the TT or a killer slot) legal in this position.
+      bool isLegalMove(move_t move) const;
       vector<Board> getLegalChildren(void) const;
 
       void makeMove(move_t move);
+      // Makes move in place, undo is filled with what unmakeMove needs to restore this board.
+      void makeMove(move_t move, UndoState *undo);
+      void unmakeMove(move_t move, const UndoState &undo);
+      // Passes the turn (clears en passant), lastMove becomes NULL_MOVE.
+      void makeNullMove(UndoState *undo);
+      void unmakeNullMove(const UndoState &undo);
       bool makeAlgebraicMove_slow(string move);
 
       // Algebraic notation of legal move from this board.
@@ -115,6 +217,11 @@ namespace board {
 
       int heuristic(void) const;
 
+      // Static Exchange Evaluation: material the side to move wins (centipawns, negative if
+      // it loses) if both sides keep recapturing on moveTo(move) with their cheapest piece.
+      // Pins are ignored.
+      int staticExchange(move_t move) const;
+
       // see RESULT_{BLACK_WIN,WHITE_WIN,TIE,IN_PROGRESS}
       board_s getGameResult_slow(void) const;
 
@@ -122,11 +229,24 @@ namespace board {
       static int getPieceValue(board_s piece);
 
     private:
-      vector<Board> getChildrenInternal_slow(void) const;
-      board_s checkAttack_medium(bool byBlack, board_s a, board_s b) const;
+      // Legal moves (to targets) for everything but the king.
+      void addPieceMoves(
+          MoveList *all_moves, int kingSquare, bitboard_t targets, unsigned char genType) const;
+      void addKingMoves(MoveList *all_moves, int kingSquare, bitboard_t targets) const;
+      void addCastles(MoveList *all_moves) const;
+      // Our pieces that are the only blocker between our king and one of their sliders.
+      bitboard_t getPinned(int kingSquare) const;
+
+      // Would our king be attacked after this (pseudo-legal) move.
+      bool leavesKingAttacked(move_t move) const;
+      board_s checkAttack(bool byBlack, board_s a, board_s b) const;
+
+      // Pieces of both colors attacking square (given occupied for the sliders).
+      bitboard_t attackersTo(int square, bitboard_t occupied) const;
+      // Squares a piece (type, without color) on square can move to ignoring pawns.
+      bitboard_t attacksFrom(board_s absPiece, int square, bitboard_t occupied) const;
 
-      pair<bool, board_s> attemptMove(board_s a, board_s b) const;
-      board_s getPiece(board_s a, board_s b) const;
+      void addMoves(MoveList *all_moves, int from, bitboard_t targets) const;
 
       void makeMove(board_s a, board_s b, board_s c, board_s d);
       void makeMove(board_s a, board_s b, board_s c, board_s d, unsigned char special);
@@ -138,24 +258,24 @@ namespace board {
       int getPSTValue(board_s a, board_s b, board_s piece) const;
 
       void updatePiece(board_s a, board_s b, board_s piece, bool movingTo);
+      // Only updates state and bitboards (unmakeMove restores everything else).
+      void setSquare(board_s a, board_s b, board_s piece);
 
       void updateZobristPiece(board_s a, board_s b, board_s piece);
       void updateZobristTurn(bool isWTurn);
       void updateZobristCastle(char castleStatus);
-      void updateZobristEnPassant(move_t &move);
+      void updateZobristEnPassant(move_t move);
 
       void promoHelper(
-          vector<Board> *all_moves,
+          MoveList *all_moves,
           board_s selfColor,
           board_s pawnDirection,
           board_s x,
           board_s y,
           board_s x2) const;
 
-      // Behavior is not defined if multiple pieces exist.
-      pair<board_s, board_s> findPiece_slow(board_s piece) const;
-
-      // Size per instance ~= 2 + 2 + 7 + 1 + 64 + 4 + 4 + 4 + 1 + 1 + 8 = 98 bytes.
+      // Size per instance = 2 + 2 + 4 + 1 + 64 + 56 + 16 + 2 + 4 + 4 + 4 + 1 + 8 = 168 bytes
+      // plus 16 bytes of alignment padding (after state, kingSquares and castleStatus) = 184.
 
       // (full move count * 2 + isBlack)
       short gameMoves;
@@ -168,6 +288,14 @@ namespace board {
 
       board_t state;
 
+      // Same position as state but as bitboards, kept in sync by updatePiece.
+      // pieces[0] is all occupied squares, pieces[PAWN..KING] are of both colors.
+      bitboard_t pieces[7];
+      // colors[isWhitePiece(piece)]
+      bitboard_t colors[2];
+      // kingSquares[isWhitePiece(piece)], kept with the bitboards (-1 till a king is placed).
+      board_s kingSquares[2];
+
       // Evaluations, measured in centipawns (100th of a pawn)
       //  +42 is tiny advantage for white, +842 is a white a queen up, -310 is a minor up for black.
       // Sum of material. (- for black, + for white)
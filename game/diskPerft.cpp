@@ -0,0 +1,40 @@
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+
+#include "board.h"
+#include "flags.h"
+#include "perft.h"
+#include "threadpool.h"
+
+using namespace std;
+using namespace board;
+using namespace search;
+using namespace threadpool;
+
+// Overnight perft runs that stream the frontier through disk (see diskPerft in perft.h).
+//   ./betachess-disk-perft --disk_perft_ply 8 --disk_perft_dir /big/disk/perft
+// Running it again with the same flags resumes from the last finished level.
+
+int main(int argc, char** argv) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  cout << "Disk perft depth (ply): " << FLAGS_disk_perft_ply
+       << " of \"" << FLAGS_disk_perft_fen << "\""
+       << " in " << FLAGS_disk_perft_dir
+       << " (" << globalPool().size() << " threads)" << endl;
+
+  auto T0 = chrono::system_clock().now();
+
+  size_t runRecords = ((size_t) FLAGS_disk_perft_run_mb << 20) / sizeof(PackedPosition);
+  long count = diskPerft(
+      FLAGS_disk_perft_fen, FLAGS_disk_perft_ply, FLAGS_disk_perft_dir, runRecords);
+
+  auto T1 = chrono::system_clock().now();
+  chrono::duration<double> duration = T1 - T0;
+  double duration_s = duration.count();
+
+  cout << "\tcount: " << count << endl;
+  printf("\tevaled: %.0f knodes/s (%.2f seconds)\n", (count / duration_s / 1000), duration_s);
+  return 0;
+}
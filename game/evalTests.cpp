@@ -27,6 +27,8 @@ int missed = 0;
 int sumAbsEval = 0;
 int countPly = 0;
 long countNodes = 0;
+long countQuiesceNodes = 0;
+int countResearches = 0;
 
 
 const int K_NODES = 1000;
@@ -54,7 +56,9 @@ void printStats(string setName) {
   cout << success << " out of (" << total << ") for set \"" << setName << "\"" << endl
        << "\t\tsum abs evals: " << sumAbsEval <<  "  (to verify no change)" << endl
        << "\t\tplys searched: " << countPly << endl
-       << "\t\tnodes counted: " << countNodes << endl;
+       << "\t\tnodes counted: " << countNodes << endl
+       << "\t\tquiesce nodes: " << countQuiesceNodes << endl
+       << "\t\tre-searches: " << countResearches << endl;
 }
 
 
@@ -89,6 +93,8 @@ bool eval(string epd) {
   sumAbsEval += abs(scoredMove.first);
   countPly   += stats.plyR;
   countNodes += stats.nodes;
+  countQuiesceNodes += stats.quiesceNodes;
+  countResearches += stats.researches;
 
   bool found = find(bestMoves.begin(), bestMoves.end(), moveName) != bestMoves.end();
   if (found) {
@@ -110,6 +116,8 @@ bool eval(string epd) {
   if (FLAGS_verbosity + infrequent >= 2) {
     cout << "\t(" << success << "/" << (success + missed) << ")" << endl;
   }
+
+  return found;
 }
 
 void evalWinAtChess0(void) {
@@ -11,9 +11,24 @@ using namespace std;
 DEFINE_int32(verbosity, 0, "print lots of stuff (higher = more)");
 
 DEFINE_int32(server_min_ply, 4, "min ply for findMove in server");
-DEFINE_int32(server_min_nodes, 75000, "min nodes for findMove in server");
+DEFINE_int32(server_min_nodes, 75000,
+    "min nodes for findMove in server (with a clock the time manager decides past this)");
+DEFINE_bool(server_ponder, true, "search the expected reply while waiting for the opponent");
+DEFINE_int32(move_overhead, 50, "min millis lost per move outside of search (network, gui)");
+DEFINE_int32(time_increment, 0, "millis added to the clock after each move");
 
 DEFINE_bool(use_ttable, false, "Use Transposition table in FindMove");
+DEFINE_int32(ttable_mb, 32, "Transposition table size in MB (rounded down to a power of two)");
+DEFINE_int32(threads, 1, "Search threads (Lazy SMP, helpers need --use_ttable)");
+DEFINE_int32(pool_threads, 0, "Worker threads for search and perft (0 = one per core)");
+DEFINE_bool(pin_threads, false, "Pin each worker thread to its own core");
+DEFINE_int32(aspiration_window, 50,
+      "Initial half width (centipawns) of the root search window, doubled on each fail (0 = off)");
+DEFINE_bool(null_move_pruning, true, "Prune nodes where passing the turn still fails high");
+DEFINE_bool(late_move_reductions, true, "Search late quiet moves at reduced depth first");
+DEFINE_double(lmr_base, 0.75, "Late move reduction = lmr_base + ln(depth) * ln(move) / lmr_divisor");
+DEFINE_double(lmr_divisor, 2.25, "Late move reduction = lmr_base + ln(depth) * ln(move) / lmr_divisor");
+DEFINE_int32(lmr_min_moves, 4, "Moves searched at full depth before late move reductions");
 
 DEFINE_string(eval_test_size, "",
       "Predetermined limits (instant, small, medium, large)");
@@ -22,6 +37,12 @@ DEFINE_int32(eval_test_custom_size, 0,
       "Custom minimum number of nodes to per eval position");
 
 DEFINE_bool(test_perft, false, "only test perft");
+DEFINE_int32(perft_cache_mb, 64, "Size of the hashed perft cache in MB");
+
+DEFINE_string(disk_perft_fen, "", "Root position for disk-perft (empty = start position)");
+DEFINE_int32(disk_perft_ply, 6, "Depth for disk-perft");
+DEFINE_string(disk_perft_dir, "perft-frontier", "Directory for disk-perft's frontier files");
+DEFINE_int32(disk_perft_run_mb, 512, "Memory for each sorted run of disk-perft in MB");
 DEFINE_bool(test_play, false, "only test perft");
 DEFINE_bool(test_simple, false, "only test update and hash");
 DEFINE_bool(test_endgame, false, "only test endgame handling");
@@ -40,11 +61,27 @@ static bool ValidateEvalTestCustomSize(const char* flagname, int flagvalue) {
          (K <= flagvalue && flagvalue <= 10 * K *K);
 }
 
+static bool ValidateTTableMegabytes(const char* flagname, int flagvalue) {
+  return 1 <= flagvalue && flagvalue <= 64 * 1024;
+}
+
+static bool ValidateThreads(const char* flagname, int flagvalue) {
+  return 1 <= flagvalue && flagvalue <= 256;
+}
+
+static bool ValidatePoolThreads(const char* flagname, int flagvalue) {
+  return 0 <= flagvalue && flagvalue <= 256;
+}
+
 // Define validators in a block here.
 
 DEFINE_validator(server_min_ply, &ValidateEvalTestCustomSize);
 DEFINE_validator(server_min_nodes, &ValidateEvalTestCustomSize);
 
+DEFINE_validator(ttable_mb, &ValidateTTableMegabytes);
+DEFINE_validator(threads, &ValidateThreads);
+DEFINE_validator(pool_threads, &ValidatePoolThreads);
+
 DEFINE_validator(eval_test_size, &ValidateEvalTestSize);
 DEFINE_validator(eval_test_custom_size, &ValidateEvalTestCustomSize);
 
@@ -12,12 +12,30 @@ DECLARE_int32(verbosity);
 
 DECLARE_int32(server_min_ply);
 DECLARE_int32(server_min_nodes);
+DECLARE_bool(server_ponder);
+DECLARE_int32(move_overhead);
+DECLARE_int32(time_increment);
 
 DECLARE_bool(use_ttable);
+DECLARE_int32(ttable_mb);
+DECLARE_int32(threads);
+DECLARE_int32(pool_threads);
+DECLARE_bool(pin_threads);
+DECLARE_int32(aspiration_window);
+DECLARE_bool(null_move_pruning);
+DECLARE_bool(late_move_reductions);
+DECLARE_double(lmr_base);
+DECLARE_double(lmr_divisor);
+DECLARE_int32(lmr_min_moves);
 DECLARE_string(eval_test_size);
 DECLARE_int32(eval_test_custom_size);
 
 DECLARE_bool(test_perft);
+DECLARE_int32(perft_cache_mb);
+DECLARE_string(disk_perft_fen);
+DECLARE_int32(disk_perft_ply);
+DECLARE_string(disk_perft_dir);
+DECLARE_int32(disk_perft_run_mb);
 DECLARE_bool(test_play);
 DECLARE_bool(test_simple);
 DECLARE_bool(test_endgame);
@@ -63,16 +63,14 @@ void repLoop(void) {
   boardT->makeMove(move);
 
   if (boardT->getLastMove() != move) {
-    cout << (int) get<0>(move) << ", " << (int) get<1>(move) << "  "
-         << (int) get<2>(move) << ", " << (int) get<3>(move) << "  w "
-         << (int) get<4>(move) << " s " << (int) get<5>(move) << " sp: "
-         << (int) get<6>(move) << endl;
+    cout << moveFrom(move) << " - " << moveTo(move) << "  w "
+         << (int) movePiece(move) << " s " << (int) moveCapture(move) << " sp: "
+         << (int) moveSpecial(move) << endl;
 
     move_t amove = boardT->getLastMove();
-    cout << (int) get<0>(amove) << ", " << (int) get<1>(amove) << "  "
-         << (int) get<2>(amove) << ", " << (int) get<3>(amove) << "  w "
-         << (int) get<4>(amove) << " s " << (int) get<5>(amove) << " sp: "
-         << (int) get<6>(amove) << endl;
+    cout << moveFrom(amove) << " - " << moveTo(amove) << "  w "
+         << (int) movePiece(amove) << " s " << (int) moveCapture(amove) << " sp: "
+         << (int) moveSpecial(amove) << endl;
   }
 
   assert(boardT->getLastMove() == move);
@@ -0,0 +1,216 @@
+#include <cassert>
+#include <cstdlib>
+
+#include "board.h"
+#include "movepick.h"
+
+using namespace std;
+using namespace board;
+using namespace search;
+
+
+void HistoryTable::clear(void) {
+  for (int color = 0; color < 2; color++) {
+    for (int from = 0; from < 64; from++) {
+      for (int to = 0; to < 64; to++) {
+        scores[color][from][to] = 0;
+      }
+    }
+  }
+}
+
+
+void HistoryTable::age(void) {
+  for (int color = 0; color < 2; color++) {
+    for (int from = 0; from < 64; from++) {
+      for (int to = 0; to < 64; to++) {
+        scores[color][from][to] /= 2;
+      }
+    }
+  }
+}
+
+
+void HistoryTable::update(bool isWhite, move_t move, int bonus) {
+  int &score = scores[isWhite][moveFrom(move)][moveTo(move)];
+  bonus = max(-HISTORY_MAX, min(HISTORY_MAX, bonus));
+  // Gravity: the closer to the limit the less a bonus (in that direction) adds.
+  score += bonus - score * abs(bonus) / HISTORY_MAX;
+}
+
+
+MovePicker::MovePicker(
+    const Board& b, move_t hashMove, move_t killer1, move_t killer2, move_t counterMove,
+    const HistoryTable* history) :
+    b(b), isWhiteTurn(b.getIsWhiteTurn()), hashMove(hashMove), history(history),
+    stage(STAGE_HASH), capturesOnly(false), refutationIndex(0), current(0), badIndex(0) {
+  refutations[0] = killer1;
+  refutations[1] = killer2;
+  refutations[2] = counterMove;
+}
+
+
+MovePicker::MovePicker(const Board& b) :
+    b(b), isWhiteTurn(b.getIsWhiteTurn()), hashMove(Board::NULL_MOVE), history(nullptr),
+    stage(STAGE_GEN_CAPTURE), capturesOnly(true), refutationIndex(0), current(0), badIndex(0) {
+  refutations[0] = Board::NULL_MOVE;
+  refutations[1] = Board::NULL_MOVE;
+  refutations[2] = Board::NULL_MOVE;
+}
+
+
+move_t MovePicker::nextMove(void) {
+  while (true) {
+    switch (stage) {
+      case STAGE_HASH:
+        stage = STAGE_GEN_CAPTURE;
+        if (b.isLegalMove(hashMove)) {
+          return hashMove;
+        }
+        hashMove = Board::NULL_MOVE;
+        break;
+
+      case STAGE_GEN_CAPTURE:
+        generate(Board::GEN_CAPTURES);
+        stage = STAGE_CAPTURE;
+        break;
+
+      case STAGE_CAPTURE: {
+        move_t move = pickBest();
+        if (move != Board::NULL_MOVE && scores[current - 1] < 0) {
+          // Best remaining loses material so all the rest do too.
+          if (capturesOnly) {
+            stage = STAGE_DONE;
+            break;
+          }
+          for (; move != Board::NULL_MOVE; move = pickBest()) {
+            badCaptures.push_back(move);
+          }
+        }
+        if (move == Board::NULL_MOVE) {
+          stage = capturesOnly ? STAGE_DONE : STAGE_KILLER;
+          break;
+        }
+        if (move != hashMove) {
+          return move;
+        }
+        break;
+      }
+
+      case STAGE_KILLER:
+      case STAGE_COUNTER:
+        if (refutationIndex == 3) {
+          stage = STAGE_GEN_QUIET;
+          break;
+        } else {
+          move_t move = refutations[refutationIndex++];
+          stage = refutationIndex < 2 ? STAGE_KILLER : STAGE_COUNTER;
+          if (isValidRefutation(move)) {
+            return move;
+          }
+          // Don't skip this move in STAGE_QUIET.
+          refutations[refutationIndex - 1] = Board::NULL_MOVE;
+        }
+        break;
+
+      case STAGE_GEN_QUIET:
+        generate(Board::GEN_QUIETS);
+        stage = STAGE_QUIET;
+        break;
+
+      case STAGE_QUIET: {
+        move_t move = pickBest();
+        if (move == Board::NULL_MOVE) {
+          stage = STAGE_BAD_CAPTURE;
+          break;
+        }
+        if (move != hashMove && !isRefutation(move)) {
+          return move;
+        }
+        break;
+      }
+
+      case STAGE_BAD_CAPTURE:
+        if (badIndex == badCaptures.size()) {
+          stage = STAGE_DONE;
+          break;
+        } else {
+          move_t move = badCaptures[badIndex++];
+          if (move != hashMove) {
+            return move;
+          }
+        }
+        break;
+
+      default:
+        return Board::NULL_MOVE;
+    }
+  }
+}
+
+
+void MovePicker::generate(unsigned char genType) {
+  moves = b.getLegalMoves(genType);
+  current = 0;
+  for (int i = 0; i < moves.size(); i++) {
+    scores[i] = moveOrderingValue(moves[i]);
+  }
+}
+
+
+move_t MovePicker::pickBest(void) {
+  if (current >= moves.size()) {
+    return Board::NULL_MOVE;
+  }
+
+  // Usually a cut-off happens in the first few moves so don't bother sorting everything.
+  int best = current;
+  for (int i = current + 1; i < moves.size(); i++) {
+    if (scores[i] > scores[best]) {
+      best = i;
+    }
+  }
+
+  move_t move = moves[best];
+  int score = scores[best];
+  moves[best] = moves[current];
+  scores[best] = scores[current];
+  moves[current] = move;
+  scores[current] = score;
+  current++;
+
+  return move;
+}
+
+
+bool MovePicker::isValidRefutation(move_t move) const {
+  // Only quiet moves (captures were all just tried), not already returned.
+  if (move == Board::NULL_MOVE || move == hashMove ||
+      moveCapture(move) != 0 || moveSpecial(move) == Board::SPECIAL_PROMOTION) {
+    return false;
+  }
+  for (int i = 0; i < refutationIndex - 1; i++) {
+    if (refutations[i] == move) {
+      return false;
+    }
+  }
+  return b.isLegalMove(move);
+}
+
+
+bool MovePicker::isRefutation(move_t move) const {
+  return move == refutations[0] || move == refutations[1] || move == refutations[2];
+}
+
+
+int MovePicker::moveOrderingValue(move_t move) const {
+  board_s capture = moveCapture(move);
+  if (capture != 0 || moveSpecial(move) == Board::SPECIAL_PROMOTION) {
+    // Captures by how much material the whole exchange wins, ties go to the bigger victim.
+    return 8 * b.staticExchange(move) + abs(capture);
+  }
+
+  // Quiet Move (sorted by how often it caused a cut-off).
+  assert( movePiece(move) != 0 );
+  return history ? history->lookup(isWhiteTurn, move) : 0;
+}
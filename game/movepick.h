@@ -0,0 +1,91 @@
+#ifndef MOVEPICK_H
+#define MOVEPICK_H
+
+#include "board.h"
+
+using namespace std;
+using namespace board;
+
+namespace search {
+  // How often a quiet move caused a cut-off, [isWhite][from][to].
+  struct HistoryTable {
+    // Gravity keeps scores within +-HISTORY_MAX (and recent results count the most).
+    static const int HISTORY_MAX = 1 << 14;
+
+    int scores[2][64][64];
+
+    void clear(void);
+    // Scales everything down so a new search (next move) can quickly overrule it.
+    void age(void);
+
+    int lookup(bool isWhite, move_t move) const {
+      return scores[isWhite][moveFrom(move)][moveTo(move)];
+    }
+
+    // bonus is positive for a cut-off, negative for a quiet move searched before the cut-off.
+    void update(bool isWhite, move_t move, int bonus);
+  };
+
+  // Hands out the moves of one node in stages so moves past a beta cut-off are never generated:
+  //   hash move, winning and even captures (by SEE), killers, counter move,
+  //   quiet moves (by history), losing captures.
+  // Board must be in the same position (but can be changed in between) each call of nextMove.
+  class MovePicker {
+    public:
+      MovePicker(
+          const Board& b, move_t hashMove, move_t killer1, move_t killer2, move_t counterMove,
+          const HistoryTable* history);
+      // Quiescence, only captures and promotions that don't lose material (by SEE).
+      explicit MovePicker(const Board& b);
+
+      // Next legal move or NULL_MOVE when all have been returned.
+      move_t nextMove(void);
+
+      // Higher is searched first, negative for captures that lose material.
+      int moveOrderingValue(move_t move) const;
+
+    private:
+      static const char STAGE_HASH        = 0;
+      static const char STAGE_GEN_CAPTURE = 1;
+      static const char STAGE_CAPTURE     = 2;
+      static const char STAGE_KILLER      = 3;
+      static const char STAGE_COUNTER     = 4;
+      static const char STAGE_GEN_QUIET   = 5;
+      static const char STAGE_QUIET       = 6;
+      static const char STAGE_BAD_CAPTURE = 7;
+      static const char STAGE_DONE        = 8;
+
+      // Fills moves (and scores) with genType moves from the board.
+      void generate(unsigned char genType);
+      // Selection sort step, returns best remaining move (NULL_MOVE if none)
+      // which is left at moves[current - 1] (and scores[current - 1]).
+      move_t pickBest(void);
+
+      // Quiet move that can be tried before generating the quiets.
+      bool isValidRefutation(move_t move) const;
+      // Killer or counter move (already returned).
+      bool isRefutation(move_t move) const;
+
+      const Board& b;
+      bool isWhiteTurn;
+
+      move_t hashMove;
+      // Both killers then the counter move.
+      move_t refutations[3];
+      const HistoryTable* history;
+
+      char stage;
+      bool capturesOnly;
+      int refutationIndex;
+
+      MoveList moves;
+      int scores[MoveList::MAX_MOVES];
+      int current;
+
+      // Captures that lose material, tried after the quiet moves.
+      MoveList badCaptures;
+      int badIndex;
+  };
+}
+
+#endif // MOVEPICK_H
@@ -0,0 +1,624 @@
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <queue>
+#include <sstream>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+
+#include "board.h"
+#include "perft.h"
+#include "threadpool.h"
+
+using namespace std;
+using namespace board;
+using namespace threadpool;
+
+namespace search {
+  // Frontier positions expanded per task.
+  const int FRONTIER_CHUNK = 4096;
+  // Frontier positions counted (perftHashed of the remaining plies) per task.
+  const int FRONTIER_COUNT_CHUNK = 64;
+  // Frontier records read from disk at a time, and expanded per task.
+  const int DISK_READ_CHUNK = 1 << 14;
+  const int DISK_TASK_CHUNK = 1024;
+
+
+  PerftCache::PerftCache(int megabytes) {
+    uint64_t size = 1;
+    while (2 * size * sizeof(Entry) <= ((uint64_t) megabytes << 20)) {
+      size *= 2;
+    }
+
+    entries = new Entry[size];
+    mask = size - 1;
+    for (uint64_t i = 0; i < size; i++) {
+      entries[i].key = 0;
+      entries[i].data = 0;
+    }
+  }
+
+
+  PerftCache::~PerftCache() {
+    delete[] entries;
+  }
+
+
+  PerftCache::Entry& PerftCache::entryFor(board_hash_t position, int ply) const {
+    // Odd multiplier so each ply of a position lands somewhere else.
+    return entries[(position ^ (ply * 0x9E3779B97F4A7C15ULL)) & mask];
+  }
+
+
+  bool PerftCache::lookup(board_hash_t position, int ply, long *count) const {
+    const Entry& entry = entryFor(position, ply);
+    uint64_t data = entry.data.load(memory_order_relaxed);
+    uint64_t key = entry.key.load(memory_order_relaxed);
+    if ((key ^ data) != position || (int) (data & 0xFF) != ply || data == 0) {
+      return false;
+    }
+
+    *count = data >> 8;
+    return true;
+  }
+
+
+  void PerftCache::store(board_hash_t position, int ply, long count) {
+    assert( 0 < ply && ply < 256 );
+    uint64_t data = ((uint64_t) count << 8) | ply;
+    Entry& entry = entryFor(position, ply);
+    entry.key.store(position ^ data, memory_order_relaxed);
+    entry.data.store(data, memory_order_relaxed);
+  }
+
+
+  static long perftCached(Board& b, int ply, PerftCache *cache) {
+    if (ply == 0) {
+      return 1;
+    }
+
+    MoveList moves = b.getLegalMoves();
+    if (ply == 1) {
+      return moves.size();
+    }
+
+    long count = 0;
+    if (cache->lookup(b.getZobrist(), ply, &count)) {
+      return count;
+    }
+
+    UndoState undo;
+    for (move_t move : moves) {
+      b.makeMove(move, &undo);
+      count += perftCached(b, ply - 1, cache);
+      b.unmakeMove(move, undo);
+    }
+
+    cache->store(b.getZobrist(), ply, count);
+    return count;
+  }
+
+
+  long perftHashed(const Board& b, int ply, PerftCache *cache) {
+    if (ply <= 1) {
+      Board root = b;
+      return perftCached(root, ply, cache);
+    }
+
+    // Root moves are pool tasks, sharing what they cache.
+    MoveList moves = b.getLegalMoves();
+    vector<long> counts(moves.size(), 0);
+    TaskGroup group(globalPool());
+    for (int mi = 0; mi < moves.size(); mi++) {
+      long *count = &counts[mi];
+      move_t move = moves[mi];
+      group.run([&b, move, ply, cache, count]() {
+        Board child = b;
+        child.makeMove(move);
+        *count = perftCached(child, ply - 1, cache);
+      });
+    }
+    group.wait();
+
+    long total = 0;
+    for (long count : counts) {
+      total += count;
+    }
+    return total;
+  }
+
+
+  // Children of frontier[begin, end) (each with its parent's multiplicity), not merged.
+  static void expandFrontier(
+      const vector<FrontierEntry>& frontier, size_t begin, size_t end,
+      vector<FrontierEntry> *children) {
+    for (size_t i = begin; i < end; i++) {
+      const FrontierEntry& parent = frontier[i];
+      for (move_t move : parent.b.getLegalMoves()) {
+        FrontierEntry child = {parent.b, parent.multiplicity};
+        child.b.makeMove(move);
+        children->push_back(child);
+      }
+    }
+  }
+
+
+  // Sorts by zobrist and sums the multiplicities of equal positions into one entry.
+  static void mergeFrontier(vector<FrontierEntry> *frontier) {
+    sort(frontier->begin(), frontier->end(),
+        [](const FrontierEntry& a, const FrontierEntry& b) {
+          return a.b.getZobrist() < b.b.getZobrist();
+        });
+
+    size_t unique = 0;
+    for (size_t i = 0; i < frontier->size(); i++) {
+      if (unique > 0 && (*frontier)[unique - 1].b.getZobrist() == (*frontier)[i].b.getZobrist()) {
+        (*frontier)[unique - 1].multiplicity += (*frontier)[i].multiplicity;
+      } else {
+        (*frontier)[unique++] = (*frontier)[i];
+      }
+    }
+    frontier->resize(unique);
+  }
+
+
+  vector<FrontierEntry> uniqueFrontier(const Board& b, int ply, vector<long> *uniqueCounts) {
+    vector<FrontierEntry> frontier = {{b, 1}};
+    if (uniqueCounts) {
+      uniqueCounts->assign(1, 1);
+    }
+
+    for (int level = 1; level <= ply; level++) {
+      // Chunks of the frontier are expanded as pool tasks into their own vectors.
+      size_t chunks = (frontier.size() + FRONTIER_CHUNK - 1) / FRONTIER_CHUNK;
+      vector<vector<FrontierEntry>> expanded(chunks);
+      TaskGroup group(globalPool());
+      for (size_t chunk = 0; chunk < chunks; chunk++) {
+        vector<FrontierEntry> *children = &expanded[chunk];
+        size_t begin = chunk * FRONTIER_CHUNK;
+        size_t end = min(frontier.size(), begin + FRONTIER_CHUNK);
+        group.run([&frontier, begin, end, children]() {
+          expandFrontier(frontier, begin, end, children);
+        });
+      }
+      group.wait();
+
+      frontier.clear();
+      for (vector<FrontierEntry>& children : expanded) {
+        frontier.insert(frontier.end(), children.begin(), children.end());
+        vector<FrontierEntry>().swap(children);
+      }
+      mergeFrontier(&frontier);
+
+      if (uniqueCounts) {
+        uniqueCounts->push_back(frontier.size());
+      }
+    }
+    return frontier;
+  }
+
+
+  long perftFrontier(const Board& b, int ply, int frontierPly, PerftCache *cache) {
+    assert( 0 <= frontierPly && frontierPly <= ply );
+    vector<FrontierEntry> frontier = uniqueFrontier(b, frontierPly, nullptr);
+
+    int remaining = ply - frontierPly;
+    size_t chunks = (frontier.size() + FRONTIER_COUNT_CHUNK - 1) / FRONTIER_COUNT_CHUNK;
+    vector<long> counts(chunks, 0);
+    TaskGroup group(globalPool());
+    for (size_t chunk = 0; chunk < chunks; chunk++) {
+      long *count = &counts[chunk];
+      size_t begin = chunk * FRONTIER_COUNT_CHUNK;
+      size_t end = min(frontier.size(), begin + FRONTIER_COUNT_CHUNK);
+      group.run([&frontier, begin, end, remaining, cache, count]() {
+        for (size_t i = begin; i < end; i++) {
+          Board position = frontier[i].b;
+          *count += frontier[i].multiplicity * perftCached(position, remaining, cache);
+        }
+      });
+    }
+    group.wait();
+
+    long total = 0;
+    for (long count : counts) {
+      total += count;
+    }
+    return total;
+  }
+
+
+  PackedPosition packPosition(const Board& b, uint64_t multiplicity) {
+    PackedPosition packed;
+    memset(&packed, 0, sizeof(packed));
+    packed.zobrist = b.getZobrist();
+    packed.multiplicity = multiplicity;
+
+    for (board_s piece = Board::PAWN; piece <= Board::KING; piece++) {
+      for (int isWhite = 0; isWhite < 2; isWhite++) {
+        int code = piece + (isWhite ? 0 : 8);
+        bitboard_t squares = b.getPieces(piece) & b.getColor(isWhite);
+        while (squares) {
+          int square = popLowestSquare(squares);
+          packed.squares[square / 2] |= code << (4 * (square % 2));
+        }
+      }
+    }
+
+    packed.flags = b.getIsWhiteTurn() | (b.getCastleStatus() << 1);
+    move_t lastMove = b.getLastMove();
+    bool doublePush = abs(movePiece(lastMove)) == Board::PAWN &&
+                      abs(moveFrom(lastMove) - moveTo(lastMove)) == 16;
+    packed.epFile = doublePush ? moveFrom(lastMove) % 8 : 8;
+    return packed;
+  }
+
+
+  Board unpackPosition(const PackedPosition& packed) {
+    board_s squares[64];
+    for (int square = 0; square < 64; square++) {
+      int code = (packed.squares[square / 2] >> (4 * (square % 2))) & 0xF;
+      squares[square] = (code & 8) ? -(code & 7) : code;
+    }
+
+    bool isWhiteTurn = packed.flags & 1;
+    move_t lastMove = Board::NULL_MOVE;
+    if (packed.epFile != 8) {
+      // Same double push the fen constructor packs, by the side that isn't to move.
+      board_s direction = isWhiteTurn ? Board::BLACK : Board::WHITE;
+      int fromRank = isWhiteTurn ? 6 : 1;
+      lastMove = packMove(fromRank, packed.epFile, fromRank + 2 * direction, packed.epFile,
+                          direction * Board::PAWN, 0, 0);
+    }
+
+    Board b(squares, isWhiteTurn, packed.flags >> 1, lastMove);
+    assert( b.getZobrist() == packed.zobrist );
+    return b;
+  }
+
+
+  PackedPosition packPosition_slow(const Board& b, uint64_t multiplicity) {
+    PackedPosition packed;
+    memset(&packed, 0, sizeof(packed));
+    packed.zobrist = b.getZobrist();
+    packed.multiplicity = multiplicity;
+
+    // "<placement> <turn> <castling> <en passant> <half moves> <moves>"
+    stringstream fen(b.generateFen_slow());
+    string placement, turn, castling, enPassant;
+    fen >> placement >> turn >> castling >> enPassant;
+
+    int rank = 7;
+    int file = 0;
+    for (char c : placement) {
+      if (c == '/') {
+        rank -= 1;
+        file = 0;
+      } else if ('1' <= c && c <= '8') {
+        file += c - '0';
+      } else {
+        int code = Board::PIECE_SYMBOL.find(tolower(c)) + (isupper(c) ? 0 : 8);
+        int square = 8 * rank + file;
+        packed.squares[square / 2] |= code << (4 * (square % 2));
+        file += 1;
+      }
+    }
+
+    packed.flags = (turn == "w");
+    for (char c : castling) {
+      if (c == 'K') { packed.flags |= Board::WHITE_OO << 1; }
+      if (c == 'Q') { packed.flags |= Board::WHITE_OOO << 1; }
+      if (c == 'k') { packed.flags |= Board::BLACK_OO << 1; }
+      if (c == 'q') { packed.flags |= Board::BLACK_OOO << 1; }
+    }
+    packed.epFile = enPassant == "-" ? 8 : enPassant[0] - 'a';
+    return packed;
+  }
+
+
+  Board unpackPosition_slow(const PackedPosition& packed) {
+    bool isWhiteTurn = packed.flags & 1;
+    char castleStatus = packed.flags >> 1;
+
+    string fen;
+    for (int rank = 7; rank >= 0; rank--) {
+      int spaces = 0;
+      for (int file = 0; file < 8; file++) {
+        int square = 8 * rank + file;
+        int code = (packed.squares[square / 2] >> (4 * (square % 2))) & 0xF;
+        if (code == 0) {
+          spaces += 1;
+          continue;
+        }
+        if (spaces > 0) {
+          fen += to_string(spaces);
+          spaces = 0;
+        }
+        char symbol = Board::PIECE_SYMBOL[code & 7];
+        fen += (code & 8) ? symbol : (char) toupper(symbol);
+      }
+      if (spaces > 0) {
+        fen += to_string(spaces);
+      }
+      fen += (rank > 0) ? "/" : "";
+    }
+
+    fen += isWhiteTurn ? " w " : " b ";
+    string castling;
+    castling += (castleStatus & Board::WHITE_OO) ? "K" : "";
+    castling += (castleStatus & Board::WHITE_OOO) ? "Q" : "";
+    castling += (castleStatus & Board::BLACK_OO) ? "k" : "";
+    castling += (castleStatus & Board::BLACK_OOO) ? "q" : "";
+    fen += (castling.empty() ? "-" : castling) + " ";
+
+    if (packed.epFile == 8) {
+      fen += "-";
+    } else {
+      fen += Board::squareName(isWhiteTurn ? 5 : 2, packed.epFile);
+    }
+    fen += " 0 1";
+
+    Board b(fen);
+    assert( b.getZobrist() == packed.zobrist );
+    return b;
+  }
+
+
+  static string levelFile(const string& dir, int level) {
+    return dir + "/level-" + to_string(level) + ".frontier";
+  }
+
+
+  static string runFile(const string& dir, int level, int run) {
+    return dir + "/level-" + to_string(level) + ".run-" + to_string(run);
+  }
+
+
+  // A missing level file means dir doesn't match its checkpoint, any count would be wrong.
+  static void openLevel(const string& dir, int level, ifstream *in) {
+    in->open(levelFile(dir, level), ios::binary);
+    if (!in->is_open()) {
+      cout << "Failed to open " << levelFile(dir, level) << endl;
+      exit(1);
+    }
+  }
+
+
+  // A short write (disk full, bad dir) would become a truncated level and a wrong count.
+  static void checkWritten(bool written, const string& path) {
+    if (!written) {
+      cout << "Failed to write " << path << endl;
+      exit(1);
+    }
+  }
+
+
+  // Reads up to count records, returns how many were read.
+  static size_t readPositions(ifstream& in, vector<PackedPosition> *positions, size_t count) {
+    positions->resize(count);
+    in.read((char*) positions->data(), count * sizeof(PackedPosition));
+    size_t read = in.gcount() / sizeof(PackedPosition);
+    positions->resize(read);
+    return read;
+  }
+
+
+  static void writePositions(const string& path, const vector<PackedPosition>& positions) {
+    ofstream out(path, ios::binary | ios::trunc);
+    out.write((const char*) positions.data(), positions.size() * sizeof(PackedPosition));
+    out.close();
+    checkWritten(out.good(), path);
+  }
+
+
+  // Orders by zobrist, then by the position itself (everything but multiplicity) so positions
+  // whose zobrists collide are never merged. Negative, zero or positive like memcmp.
+  static int comparePositions(const PackedPosition& a, const PackedPosition& b) {
+    if (a.zobrist != b.zobrist) {
+      return a.zobrist < b.zobrist ? -1 : 1;
+    }
+    return memcmp(a.squares, b.squares,
+                  offsetof(PackedPosition, padding) - offsetof(PackedPosition, squares));
+  }
+
+
+  // Sorts and sums the multiplicities of equal positions into one record.
+  static void mergeRun(vector<PackedPosition> *run) {
+    sort(run->begin(), run->end(),
+        [](const PackedPosition& a, const PackedPosition& b) {
+          return comparePositions(a, b) < 0;
+        });
+
+    size_t unique = 0;
+    for (size_t i = 0; i < run->size(); i++) {
+      if (unique > 0 && comparePositions((*run)[unique - 1], (*run)[i]) == 0) {
+        (*run)[unique - 1].multiplicity += (*run)[i].multiplicity;
+      } else {
+        (*run)[unique++] = (*run)[i];
+      }
+    }
+    run->resize(unique);
+  }
+
+
+  // Runs parallel over chunks of parents, perChunk(begin, end, chunkIndex).
+  static void forEachChunk(size_t size, function<void(size_t, size_t, size_t)> perChunk) {
+    size_t chunks = (size + DISK_TASK_CHUNK - 1) / DISK_TASK_CHUNK;
+    TaskGroup group(globalPool());
+    for (size_t chunk = 0; chunk < chunks; chunk++) {
+      size_t begin = chunk * DISK_TASK_CHUNK;
+      size_t end = min(size, begin + DISK_TASK_CHUNK);
+      group.run([&perChunk, begin, end, chunk]() { perChunk(begin, end, chunk); });
+    }
+    group.wait();
+  }
+
+
+  // Children of every position in level's file, as sorted runs merged into level + 1's file.
+  static void expandLevel(const string& dir, int level, size_t runRecords) {
+    // A run is written once it has runRecords, it can go over by one read's children.
+    size_t readSize = max((size_t) 1, min((size_t) DISK_READ_CHUNK, runRecords));
+    vector<PackedPosition> run;
+    int runs = 0;
+
+    ifstream in;
+    openLevel(dir, level, &in);
+    vector<PackedPosition> parents;
+    while (readPositions(in, &parents, readSize) > 0) {
+      vector<vector<PackedPosition>> expanded((parents.size() + DISK_TASK_CHUNK - 1) / DISK_TASK_CHUNK);
+      forEachChunk(parents.size(), [&parents, &expanded](size_t begin, size_t end, size_t chunk) {
+        for (size_t i = begin; i < end; i++) {
+          Board b = unpackPosition(parents[i]);
+          for (move_t move : b.getLegalMoves()) {
+            Board child = b;
+            child.makeMove(move);
+            expanded[chunk].push_back(packPosition(child, parents[i].multiplicity));
+          }
+        }
+      });
+
+      for (vector<PackedPosition>& children : expanded) {
+        run.insert(run.end(), children.begin(), children.end());
+      }
+      if (run.size() >= runRecords) {
+        mergeRun(&run);
+        writePositions(runFile(dir, level + 1, runs++), run);
+        run.clear();
+      }
+    }
+    mergeRun(&run);
+    writePositions(runFile(dir, level + 1, runs++), run);
+    vector<PackedPosition>().swap(run);
+
+    // k-way merge of the sorted runs, duplicates across runs are summed here.
+    vector<unique_ptr<ifstream>> inputs;
+    vector<PackedPosition> current(runs);
+    // Run whose current record comes first on top.
+    auto later = [&current](int a, int b) { return comparePositions(current[a], current[b]) > 0; };
+    priority_queue<int, vector<int>, decltype(later)> heads(later);
+    for (int r = 0; r < runs; r++) {
+      inputs.emplace_back(new ifstream(runFile(dir, level + 1, r), ios::binary));
+      if (inputs[r]->read((char*) &current[r], sizeof(PackedPosition))) {
+        heads.push(r);
+      }
+    }
+
+    ofstream out(levelFile(dir, level + 1), ios::binary | ios::trunc);
+    PackedPosition pending;
+    bool hasPending = false;
+    while (!heads.empty()) {
+      int r = heads.top();
+      heads.pop();
+
+      if (hasPending && comparePositions(pending, current[r]) == 0) {
+        pending.multiplicity += current[r].multiplicity;
+      } else {
+        if (hasPending) {
+          out.write((const char*) &pending, sizeof(PackedPosition));
+        }
+        pending = current[r];
+        hasPending = true;
+      }
+
+      if (inputs[r]->read((char*) &current[r], sizeof(PackedPosition))) {
+        heads.push(r);
+      }
+    }
+    if (hasPending) {
+      out.write((const char*) &pending, sizeof(PackedPosition));
+    }
+    out.close();
+    checkWritten(out.good(), levelFile(dir, level + 1));
+
+    for (int r = 0; r < runs; r++) {
+      remove(runFile(dir, level + 1, r).c_str());
+    }
+    // Also any left over from an interrupted attempt at this level (that made more runs).
+    int leftover = runs;
+    while (remove(runFile(dir, level + 1, leftover).c_str()) == 0) {
+      leftover++;
+    }
+  }
+
+
+  // Last finished level of fen's run in dir, -1 if there is none.
+  static int readCheckpoint(const string& dir, const string& fen) {
+    ifstream in(dir + "/checkpoint");
+    string checkpointFen;
+    int level = -1;
+    if (!getline(in, checkpointFen) || !(in >> level) || checkpointFen != fen) {
+      return -1;
+    }
+    return level;
+  }
+
+
+  static void writeCheckpoint(const string& dir, const string& fen, int level) {
+    // Written aside and renamed so a crash never leaves half a checkpoint.
+    string path = dir + "/checkpoint";
+    ofstream out(path + ".tmp", ios::trunc);
+    out << fen << endl << level << endl;
+    out.close();
+    checkWritten(out.good(), path + ".tmp");
+    checkWritten(rename((path + ".tmp").c_str(), path.c_str()) == 0, path);
+  }
+
+
+  long diskPerft(const string& fen, int ply, const string& dir, size_t runRecords) {
+    Board root = fen.empty() ? Board() : Board(fen);
+    if (ply == 0) {
+      return 1;
+    }
+
+    mkdir(dir.c_str(), 0755);
+
+    int level = readCheckpoint(dir, fen);
+    if (level >= ply) {
+      // An earlier run went deeper, the level this one counts from was already removed.
+      cout << "Restarting " << dir << " (checkpoint at level " << level << ")" << endl;
+      remove(levelFile(dir, level).c_str());
+      level = -1;
+    }
+    if (level < 0) {
+      writePositions(levelFile(dir, 0), {packPosition(root, 1)});
+      level = 0;
+      writeCheckpoint(dir, fen, level);
+    } else {
+      cout << "Resuming " << dir << " from level " << level << endl;
+    }
+
+    // The last level is only counted (never written).
+    for (; level + 1 < ply; level++) {
+      expandLevel(dir, level, runRecords);
+      writeCheckpoint(dir, fen, level + 1);
+      remove(levelFile(dir, level).c_str());
+    }
+
+    long total = 0;
+    ifstream in;
+    openLevel(dir, ply - 1, &in);
+    vector<PackedPosition> positions;
+    while (readPositions(in, &positions, DISK_READ_CHUNK) > 0) {
+      vector<long> counts((positions.size() + DISK_TASK_CHUNK - 1) / DISK_TASK_CHUNK, 0);
+      forEachChunk(positions.size(), [&positions, &counts](size_t begin, size_t end, size_t chunk) {
+        for (size_t i = begin; i < end; i++) {
+          Board b = unpackPosition(positions[i]);
+          counts[chunk] += positions[i].multiplicity * b.getLegalMoves().size();
+        }
+      });
+      for (long count : counts) {
+        total += count;
+      }
+    }
+    return total;
+  }
+}
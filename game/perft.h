@@ -0,0 +1,85 @@
+#ifndef PERFT_H
+#define PERFT_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "board.h"
+
+using namespace std;
+using namespace board;
+
+// Perft variants for deep counts, Search::perft is the plain (category counting) one.
+namespace search {
+  // Fixed size (zobrist, plies) -> leaf count table, safe to share between threads.
+  class PerftCache {
+    public:
+      // Rounded down to a power of two entries.
+      explicit PerftCache(int megabytes);
+      ~PerftCache();
+
+      bool lookup(board_hash_t position, int ply, long *count) const;
+      // Always replaces, different plies of one position go to different entries.
+      void store(board_hash_t position, int ply, long count);
+
+    private:
+      // data is (count << 8 | ply), key is stored as (zobrist ^ data) like the TT.
+      struct Entry {
+        atomic<uint64_t> key;
+        atomic<uint64_t> data;
+      };
+
+      Entry& entryFor(board_hash_t position, int ply) const;
+
+      Entry *entries;
+      uint64_t mask;
+  };
+
+  // A position and how many move orders (from the root) reach it.
+  struct FrontierEntry {
+    Board b;
+    long multiplicity;
+  };
+
+  // Leaf count of b's tree, subtree counts are cached in (and reused from) cache.
+  long perftHashed(const Board& b, int ply, PerftCache *cache);
+
+  // Distinct positions ply moves from b, expanded level by level with duplicates merged by
+  // zobrist. uniqueCounts (if given) gets the number of distinct positions at each level.
+  vector<FrontierEntry> uniqueFrontier(const Board& b, int ply, vector<long> *uniqueCounts);
+
+  // Same count as perftHashed, but from the unique frontier frontierPly deep (each entry counted
+  // once and multiplied by how often it's reached).
+  long perftFrontier(const Board& b, int ply, int frontierPly, PerftCache *cache);
+
+  // Fixed size (56 byte) frontier record for diskPerft.
+  struct PackedPosition {
+    board_hash_t zobrist;
+    uint64_t multiplicity;
+    // 4 bits per square (a1 = low bits of squares[0]): 0 empty, 1-6 white pawn..king, 9-14 black.
+    uint8_t squares[32];
+    // Bit 0 white to move, bits 1-4 castle status.
+    uint8_t flags;
+    // File of a pawn that was just pushed two, 8 if none.
+    uint8_t epFile;
+    uint8_t padding[6];
+  };
+
+  // Only what changes perft (the move counters are reset).
+  PackedPosition packPosition(const Board& b, uint64_t multiplicity);
+  Board unpackPosition(const PackedPosition& packed);
+  // Same through FEN, to check the above in tests.
+  PackedPosition packPosition_slow(const Board& b, uint64_t multiplicity);
+  Board unpackPosition_slow(const PackedPosition& packed);
+
+  // Perft of fen with the frontier on disk in dir (created if missing). Each level is expanded
+  // in chunks into sorted runs of about runRecords positions, which are merged (summing the
+  // multiplicities of duplicates) into the next level's file. dir/checkpoint records the last
+  // finished level so a run started again with the same fen picks up from there (or starts over
+  // if it's past ply - 1). Exits if a level file the checkpoint needs is missing.
+  long diskPerft(const string& fen, int ply, const string& dir, size_t runRecords);
+}
+
+#endif // PERFT_H
@@ -4,16 +4,18 @@
 #include <cctype>
 #include <chrono>
 #include <cmath>
+#include <functional>
 #include <iostream>
-#include <random>
 #include <string>
-#include <thread>
 #include <vector>
 
 #include "board.h"
 #include "book.h"
 #include "flags.h"
+#include "movepick.h"
 #include "search.h"
+#include "threadpool.h"
+#include "timeman.h"
 #include "ttable.h"
 //Maybe needed in future
 //#include "polyglot.h"
@@ -23,6 +25,7 @@ using namespace std;
 using namespace book;
 using namespace board;
 using namespace search;
+using namespace threadpool;
 using namespace ttable;
 
 //  Have to declare static variable here or something;
@@ -42,13 +45,33 @@ Search::Search(Board rootB, bool withTimeControl) {
 }
 
 
+Search::~Search() {
+  stopPonder();
+}
+
+
 void Search::setup() {
-  nodeCounter = 0;
-  ttCounter = 0;
-  quiesceCounter = 0;
+  globalStop = false;
+  hardStopTime = 0;
+  wCurrentTime = 0;
+  bCurrentTime = 0;
+  helpersStop = false;
+  pondering = false;
+  ponderConfirmed = 0;
+
+  // New game, nothing in the TT is useful (and it's kept between moves).
+  if (FLAGS_use_ttable) {
+    clearTT();
+  }
 
-  // Has the right shape :)
-  move_time_dist = gamma_distribution<double>(8.0, 0.2);
+  // reduction ~= base + ln(depth) * ln(move number) / divisor
+  for (int depth = 0; depth < MAX_PLY; depth++) {
+    for (int moveNumber = 0; moveNumber < LMR_MAX_MOVES; moveNumber++) {
+      double reduction = (depth == 0 || moveNumber < FLAGS_lmr_min_moves) ? 0 :
+          FLAGS_lmr_base + log(depth) * log(moveNumber) / FLAGS_lmr_divisor;
+      lmrTable[depth][moveNumber] = max(0, (int) reduction);
+    }
+  }
 }
 
 
@@ -60,6 +83,7 @@ void Search::save() {
 
 
 void Search::load(int number) {
+  stopPonder();
   moveNames.clear();
   moves.clear();
 
@@ -68,6 +92,11 @@ void Search::load(int number) {
 
   // Reset root board.
   root = Board();
+  threads.clear();
+  timeManager.reset();
+  if (FLAGS_use_ttable) {
+    clearTT();
+  }
 
   // Playback all the moves.
   for (string move : moveList) {
@@ -77,13 +106,17 @@ void Search::load(int number) {
 
 
 Board const Search::getRoot() {
-  return root;
+  return ponderTask ? ponderBase : root;
 }
 
 
 void Search::makeMove(move_t move) {
-  string alg = root.algebraicNotation_slow(move);
-  root.makeMove(move);
+  Board b = getRoot();
+  string alg = b.algebraicNotation_slow(move);
+  b.makeMove(move);
+  if (!confirmPonderMove(move)) {
+    root = b;
+  }
 
   moveNames.push_back(alg);
   moves.push_back(move);
@@ -91,39 +124,89 @@ void Search::makeMove(move_t move) {
 
 
 bool Search::makeAlgebraicMove(string move) {
-  bool valid = root.makeAlgebraicMove_slow(move);
+  Board b = getRoot();
+  bool valid = b.makeAlgebraicMove_slow(move);
   if (valid) {
+    if (!confirmPonderMove(b.getLastMove())) {
+      root = b;
+    }
+
     moveNames.push_back(move);
-    moves.push_back(root.getLastMove());
+    moves.push_back(b.getLastMove());
   }
 
   return valid;
 }
 
 
-void Search::updateTime(long wTime, long bTime) {
-  wMaxTime = max(wMaxTime, wTime);
-  bMaxTime = max(bMaxTime, bTime);
+void Search::startPonder(move_t move, move_t reply, int minPly, int minNodes) {
+  stopPonder();
+  if (move == Board::NULL_MOVE || reply == Board::NULL_MOVE) {
+    return;
+  }
 
-  wCurrentTime = wTime;
-  bCurrentTime = bTime;
+  ponderBase = root;
+  ponderMoves = {move, reply};
+  ponderConfirmed = 0;
+  root.makeMove(move);
+  root.makeMove(reply);
+
+  // No time limit till the reply is played (see findMove).
+  hardStopTime = 0;
+  globalStop.store(false, memory_order_release);
+  pondering = true;
+  ponderTask.reset(new TaskGroup(globalPool()));
+  ponderTask->run([this, minPly, minNodes]() {
+    ponderResult = findMoveInner(minPly, minNodes, &ponderStats);
+  });
 }
 
 
-long Search::getTimeForMove_millis() {
-  long currentTime = root.getIsWhiteTurn() ? wCurrentTime : bCurrentTime;
-  long remainingMoves = max((int) (60 - moves.size()), 30);
-  long maxOkayTime = currentTime / remainingMoves;
+void Search::stopPonder() {
+  if (!ponderTask) {
+    return;
+  }
+
+  globalStop.store(true, memory_order_release);
+  ponderTask->wait();
+  ponderTask.reset();
+  pondering = false;
 
-  double tRand = move_time_dist(generator);
-  long finalTime = tRand * maxOkayTime;
-  return min(20000L, max(finalTime, 100L));
+  // Back to the game position (with the moves that were played).
+  root = ponderBase;
+  ponderMoves.clear();
+  ponderConfirmed = 0;
+}
+
+
+bool Search::confirmPonderMove(move_t move) {
+  if (!ponderTask) {
+    return false;
+  }
+
+  if (ponderConfirmed < ponderMoves.size() && ponderMoves[ponderConfirmed] == move) {
+    ponderBase.makeMove(move);
+    ponderConfirmed += 1;
+    return true;
+  }
+
+  if (FLAGS_verbosity >= 1) {
+    cout << "ponder miss, stopping ponder search" << endl;
+  }
+  stopPonder();
+  return false;
+}
+
+
+void Search::updateTime(long wTime, long bTime) {
+  wCurrentTime = wTime;
+  bCurrentTime = bTime;
 }
 
 
 long Search::getCurrentTime_millis() {
   return chrono::duration_cast<chrono::milliseconds>(
-      chrono::system_clock::now().time_since_epoch()).count();
+      chrono::steady_clock::now().time_since_epoch()).count();
 }
 
 
@@ -131,140 +214,223 @@ long Search::getCurrentTime_millis() {
 /* Code below is algorithmic, above is status                                */
 /*****************************************************************************/
 
-void Search::orderChildren(vector<Board> &children) {
-  //auto comparitor = [](const Board&a, const Board&b) {
-  //  return Search::moveOrderingValue(a) > Search::moveOrderingValue(b);
-  //};
-  //sort(children.begin(), children.end(), comparitor);
-  //return;
+void SearchThread::reset(const Board& root) {
+  b = root;
+  plySearchDepth = 0;
+  nodes = 0;
+  quiesceNodes = 0;
+  ttHits = 0;
+  nullMoveTries = 0;
+  nullMoveCutoffs = 0;
+  lmrReductions = 0;
+  lmrResearches = 0;
+  timeCheckNodes = 0;
+  prevPvLength = 0;
+  followPv = false;
+}
 
-  int n = children.size();
 
-  pair<int, int> test[n];
-  for (int i = 0; i < n; i++) {
-    test[i] = make_pair(Search::moveOrderingValue(children[i]), i);
-  }
+scored_move_t Search::searchNodeForTesting(
+    int ply, int plyR, int alpha, int beta, long *nullMoveTries) {
+  unique_ptr<SearchThread> t(new SearchThread());
+  // Not the main thread, so the clock is never looked at.
+  t->id = 1;
+  t->reset(root);
+  clearMoveOrdering(*t);
+
+  scored_move_t result = findMoveHelper(*t, ply, plyR, alpha, beta);
+  *nullMoveTries = t->nullMoveTries;
+  return result;
+}
 
-  auto comparitor = [](const pair<int, int>&a, const pair<int, int>&b) { return a.first > b.first; };
-  sort(test, test + n, comparitor);
 
-  vector<Board> result;
-  for (int i = 0; i < n; i++) {
-    result.push_back(children[get<1>(test[i])]);
+void Search::clearMoveOrdering(SearchThread& t) {
+  for (int ply = 0; ply < MAX_PLY; ply++) {
+    t.killers[ply][0] = Board::NULL_MOVE;
+    t.killers[ply][1] = Board::NULL_MOVE;
+  }
+
+  for (int from = 0; from < 64; from++) {
+    for (int to = 0; to < 64; to++) {
+      t.counterMoves[from][to] = Board::NULL_MOVE;
+    }
   }
 
-  swap(children, result);
-  return;
+  t.history.clear();
 }
 
 
-int Search::moveOrderingValue(const Board& b) {
-  // 4. "Good" captures (taking higher value piece)
-  // 3. Equal captures  (taking piece of ~equal~ value)
-  // 2. Scary looking captures
-  // 1. Quiet moves     (move with no capture)
+void Search::ageMoveOrdering(SearchThread& t) {
+  for (int ply = 0; ply < MAX_PLY; ply++) {
+    t.killers[ply][0] = Board::NULL_MOVE;
+    t.killers[ply][1] = Board::NULL_MOVE;
+  }
 
-  const int MAJOR_ORDERING = 1000000;
+  t.history.age();
+}
 
-  move_t lastMove = b.getLastMove();
-  board_s moving  = abs(get<4>(lastMove));
-  board_s capture = abs(get<5>(lastMove));
-
-  assert( moving != 0 );
-  int movingValue = Board::getPieceValue(moving);
-
-  int fromS = (get<0>(lastMove) << 3) + get<1>(lastMove);
-  int toS = (get<2>(lastMove) << 3) + get<3>(lastMove);
-  int historyHeuristic = lookupHistory(b.getIsWhiteTurn(), fromS, toS);
-  // int historyHeuristic = 0;
-
-  int captureScore = 0;
-  if (capture != 0) {
-    int captureValue = Board::getPieceValue(capture);
-    if (captureValue > movingValue) {
-      // Good captures
-      captureScore = 4 * MAJOR_ORDERING + captureValue - movingValue;
-    } else if (captureValue >= (movingValue - 50)) {
-      // Equal Captures (including bishop for knight)
-      captureScore = 3 * MAJOR_ORDERING + captureValue;
-    } else {
-      assert (captureValue < movingValue);
-      // These moves might be good but they are scary to evaluate.
-      captureScore = 2 * MAJOR_ORDERING + captureValue;
-    }
-  } else {
-    // Quiet Move (sorted by how heavy a piece we are moving).
-    captureScore = 1 * MAJOR_ORDERING + movingValue;
+
+void Search::updateMoveOrdering(
+    SearchThread& t, int ply, char plyR, move_t move, const MoveList& quietsTried) {
+  // Captures and promotions are already searched early.
+  if (moveCapture(move) != 0 || moveSpecial(move) == Board::SPECIAL_PROMOTION) {
+    return;
   }
 
-  return captureScore + historyHeuristic;
-}
+  if (t.killers[ply][0] != move) {
+    t.killers[ply][1] = t.killers[ply][0];
+    t.killers[ply][0] = move;
+  }
 
-void Search::stopAfterAllocatedTime(int allocatedTime) {
-  long endTime = getCurrentTime_millis() + allocatedTime;
-  while (!globalStop && getCurrentTime_millis() < endTime) {
-    this_thread::sleep_for(chrono::milliseconds(10));
+  move_t lastMove = t.b.getLastMove();
+  t.counterMoves[moveFrom(lastMove)][moveTo(lastMove)] = move;
+
+  // Deeper cut-offs are more reliable.
+  bool isWhiteTurn = t.b.getIsWhiteTurn();
+  int bonus = plyR * plyR;
+  t.history.update(isWhiteTurn, move, bonus);
+  for (move_t quiet : quietsTried) {
+    t.history.update(isWhiteTurn, quiet, -bonus);
   }
+}
 
-  // TODO: Figure out how to prevent breaking before plyR = 2 finishes.
-  globalStop = true;
+
+void Search::checkTime(SearchThread& t) {
+  t.timeCheckNodes = 0;
+
+  // The first iteration (plySearchDepth = 2) always finishes so there is a move to play.
+  long hardStop = hardStopTime.load(memory_order_acquire);
+  if (hardStop != 0 && t.plySearchDepth > 2 && getCurrentTime_millis() >= hardStop) {
+    globalStop.store(true, memory_order_release);
+  }
 }
 
 
 // Public method that setups and calls helper method.
 scored_move_t Search::findMove(int minPly, int minNodes, FindMoveStats *stats) {
-  globalStop = false;
+  // Both ponder moves were played, the ponder search (already some plies deep) becomes this one.
+  bool ponderHit = ponderTask && ponderConfirmed == ponderMoves.size();
+  if (!ponderHit) {
+    stopPonder();
+    globalStop.store(false, memory_order_release);
+  }
+
   searchStartTime = getCurrentTime_millis();
-  long allocatedTime = useTimeControl ? getTimeForMove_millis() : 0;
-  thread t1;
+  long allocatedTime = 0;
+  long hardStop = 0;
+  long currentTime = root.getIsWhiteTurn() ? wCurrentTime : bCurrentTime;
+  // Without a clock (updateTime never called) only minNodes limits the search, with one it's
+  // the least searched before the time manager can stop.
+  bool timeLimited = useTimeControl && currentTime > 0;
+  if (timeLimited) {
+    timeManager.startSearch(currentTime, moves.size());
+    allocatedTime = timeManager.optimumTime();
+    hardStop = searchStartTime + timeManager.maximumTime();
+  }
+  hardStopTime.store(hardStop, memory_order_release);
 
   if (useTimeControl) {
     if (FLAGS_verbosity >= 1) {
-      cout << "findingAMove " << moves.size() << " moves in" << endl;
+      cout << "findingAMove " << moves.size() << " moves in"
+           << (ponderHit ? " (ponder hit)" : "") << endl;
       cout << "\tcurrent fen: " << root.generateFen_slow() << endl;
-      cout << "\tallocated " << allocatedTime << " millis " << endl;
+      cout << "\tallocated " << allocatedTime << " millis"
+           << " (max " << timeManager.maximumTime()
+           << ", overhead " << timeManager.moveOverhead() << ")" << endl;
       root.printBoard();
       cout << endl;
     }
 
     // TODO: Retrieve book lookup and stuff from old server code.
     // TODO: pull out simple cases?
-
-    t1 = thread(&Search::stopAfterAllocatedTime, this, allocatedTime);
   }
 
-  scored_move_t result = findMoveInner(minPly, minNodes, stats);
+  scored_move_t result;
+  if (ponderHit) {
+    // Now limited by time and minNodes like any other search (the limits are stored above).
+    pondering.store(false, memory_order_release);
+    ponderTask->wait();
+    ponderTask.reset();
+    ponderMoves.clear();
+    ponderConfirmed = 0;
+
+    result = ponderResult;
+    if (stats) {
+      *stats = ponderStats;
+    }
+  } else {
+    result = findMoveInner(minPly, minNodes, stats);
+  }
 
   long searchEndTime = getCurrentTime_millis();
   long duration = searchEndTime - searchStartTime;
 
-  if (FLAGS_verbosity >= 2) {
-    cout << "\tsearch took " << duration <<
-            " (allocated " << allocatedTime << ")" << endl;
+  if (timeLimited) {
+    timeManager.endSearch(duration);
   }
 
-  if (useTimeControl) {
-    // if stopAfterAllocatedTime hasn't finished clue it to stop.
-    globalStop = true;
-    t1.join();
+  if (FLAGS_verbosity >= 2) {
+    cout << "\tsearch took " << duration << " (allocated " << allocatedTime
+         << (timeLimited ? ", planned " + to_string(timeManager.optimumTime()) : "")
+         << ")" << endl;
   }
 
   return result;
 }
 
 
+int Search::lateMoveReduction(int plyR, int moveNumber) const {
+  return lmrTable[min(plyR, MAX_PLY - 1)][min(moveNumber, LMR_MAX_MOVES - 1)];
+}
+
+
+long Search::totalNodes() {
+  long nodes = 0;
+  for (auto& t : threads) {
+    nodes += t->nodes + t->quiesceNodes;
+  }
+  return nodes;
+}
+
+
+long Search::totalTTHits() {
+  long hits = 0;
+  for (auto& t : threads) {
+    hits += t->ttHits;
+  }
+  return hits;
+}
+
+
 // Takes care of calling iterative deepening till outer thread
 scored_move_t Search::findMoveInner(int minPly, int minNodes, FindMoveStats *stats) {
-  nodeCounter = 0;
-  ttCounter = 0;
-  quiesceCounter = 0;
+  // Helpers only communicate through the transposition table.
+  int numThreads = FLAGS_use_ttable ? FLAGS_threads : 1;
+  // Threads (and their move ordering) are kept between moves.
+  for (auto& t : threads) {
+    ageMoveOrdering(*t);
+  }
+  while ((int) threads.size() < numThreads) {
+    threads.emplace_back(new SearchThread());
+    clearMoveOrdering(*threads.back());
+  }
+  threads.resize(numThreads);
 
-  clearTT();
-  clearHistory();
+  for (int id = 0; id < numThreads; id++) {
+    threads[id]->id = id;
+    threads[id]->reset(root);
+  }
+
+  if (FLAGS_use_ttable) {
+    newSearchTT();
+  }
 
   if (stats) {
     stats->plyR = 0;
     stats->nodes = 0;
+    stats->quiesceNodes = 0;
+    stats->researches = 0;
+    stats->pv.clear();
   }
 
   // Check if game has a result
@@ -276,209 +442,486 @@ scored_move_t Search::findMoveInner(int minPly, int minNodes, FindMoveStats *sta
 
   // Check if we only have one move (if so no real choice).
   // Really useful for anti chess where this happens often.
-  auto c = root.getLegalChildren();
-  if (c.size() == 1) {
-    return make_pair(NAN, c[0].getLastMove());
+  auto legal = root.getLegalMoves();
+  if (legal.size() == 1) {
+    return make_pair(NAN, legal[0]);
+  }
+
+  // Helpers fill the TT (at other depths) while this thread does the real iterative deepening.
+  helpersStop = false;
+  TaskGroup helpers(globalPool());
+  for (int id = 1; id < numThreads; id++) {
+    SearchThread* helper = threads[id].get();
+    helpers.run([this, helper]() { helperSearch(*helper); });
   }
 
-  // Update the global state.
-  plySearchDepth = 2;
+  SearchThread& main = *threads[0];
+  main.plySearchDepth = 2;
 
   // Checkmate this turn
   int maxScore = Search::SCORE_WIN + 101;
 
+  main.followPv = true;
   scored_move_t scoredMove;
-  int totalNodes = 0;
+  long nodes = 0;
+  int researches = 0;
+  long iterationStart = getCurrentTime_millis();
+  long lastIterationTime = 0;
   while (true) {
-    scored_move_t test = findMoveHelper(root, plySearchDepth, -maxScore, maxScore);
-    if (globalStop || test.first == SCORE_INTERRUPT) {
+    // First couple of iterations are cheap and their scores jumpy.
+    bool useWindow = FLAGS_aspiration_window > 0 && main.plySearchDepth > 3 &&
+                     abs(scoredMove.first) < Search::SCORE_WIN;
+    scored_move_t test = useWindow ?
+        aspirationSearch(main, scoredMove.first, &researches) :
+        findMoveHelper(main, 0, main.plySearchDepth, -maxScore, maxScore);
+    if (globalStop.load(memory_order_acquire) || test.first == SCORE_INTERRUPT) {
       break;
     }
 
     scoredMove = test;
-    totalNodes = nodeCounter + quiesceCounter;
+    nodes = totalNodes();
+    savePv(main);
+
+    // Each ply costs about as many times more than the last as the last did over the one before.
+    long now = getCurrentTime_millis();
+    long iterationTime = now - iterationStart;
+    double growth = lastIterationTime > 0 ?
+        min(4.0, max(1.5, (double) iterationTime / lastIterationTime)) : 2.0;
+    iterationStart = now;
+    lastIterationTime = iterationTime;
+
+    // After a ponder hit findMove has started the time manager before clearing pondering.
+    bool timeLimited = !pondering.load(memory_order_acquire);
+    bool outOfTime = false;
+    if (timeLimited && hardStopTime.load(memory_order_relaxed) != 0) {
+      int rootScore = root.getIsWhiteTurn() ? scoredMove.first : -scoredMove.first;
+      timeManager.iterationDone(scoredMove.second, rootScore);
+      outOfTime = timeManager.shouldStop(now - searchStartTime, growth * iterationTime);
+    }
 
     if (FLAGS_verbosity >= 2) {
-      cout << "\tply: " << plySearchDepth << ", score: " << scoredMove.first
-           << " (" << totalNodes << " nodes)" << endl;
+      vector<move_t> pv(main.prevPv, main.prevPv + main.prevPvLength);
+      cout << "\tply: " << main.plySearchDepth << ", score: " << scoredMove.first
+           << " (" << nodes << " nodes) pv: " << pvString(root, pv) << endl;
     }
 
-    if (abs(scoredMove.first) >= Search::SCORE_WIN || totalNodes > minNodes) {
+    // With a clock the time manager decides when to stop (minNodes is only a floor), without
+    // one minNodes does.
+    bool hasClock = hardStopTime.load(memory_order_relaxed) != 0;
+    bool enoughNodes = nodes > minNodes && timeLimited;
+    bool done = hasClock ? (outOfTime && enoughNodes) : enoughNodes;
+    if (abs(scoredMove.first) >= Search::SCORE_WIN || done ||
+        main.plySearchDepth + 1 >= MAX_PLY) {
       break;
     }
 
-    plySearchDepth += 1;
+    main.plySearchDepth += 1;
+    main.followPv = true;
   }
 
+  helpersStop = true;
+  helpers.wait();
+
   // scoredMove.first == NAN when it's a forced move, otherwise the in search window.
   assert (-maxScore <= scoredMove.first && scoredMove.first <= maxScore);
 
   string name = root.algebraicNotation_slow(scoredMove.second);
   string ttableDebug = !FLAGS_use_ttable ?
-    "" : ("(tt " + to_string(sizeTT()) + ", " + to_string(Search::ttCounter) + ")");
+    "" : ("(tt " + to_string(hashfullTT()) + "/1000 full, " + to_string(totalTTHits()) + ")");
 
   if (stats) {
-    stats->plyR = plySearchDepth;
-    stats->nodes = totalNodes;
+    stats->plyR = main.plySearchDepth;
+    stats->nodes = nodes;
+    stats->researches = researches;
+    stats->pv.assign(main.prevPv, main.prevPv + main.prevPvLength);
+    stats->quiesceNodes = 0;
+    for (auto& t : threads) {
+      stats->quiesceNodes += t->quiesceNodes;
+    }
   }
 
   if (FLAGS_verbosity >= 2) {
-    cout << "\t\tplyR " << plySearchDepth << "=> "
-         << nodeCounter << " + " << quiesceCounter << " nodes "
+    cout << "\t\tplyR " << main.plySearchDepth << "=> "
+         << main.nodes << " + " << main.quiesceNodes << " nodes "
          << ttableDebug
+         << " (" << researches << " re-searches)"
+         << " (null " << main.nullMoveCutoffs << "/" << main.nullMoveTries << ")"
+         << " (lmr " << main.lmrResearches << "/" << main.lmrReductions << ")"
          << " => " << name << " (@ " << scoreString(scoredMove.first) << ")" << endl;
+
+    for (int id = 1; id < numThreads; id++) {
+      cout << "\t\thelper " << id << " plyR " << threads[id]->plySearchDepth << "=> "
+           << threads[id]->nodes << " + " << threads[id]->quiesceNodes << " nodes" << endl;
+    }
   }
 
   return scoredMove;
 }
 
 
-scored_move_t Search::findMoveHelper(const Board& b, char plyR, int alpha, int beta) {
-  // TODO except at ROOT this doesn't need to return a move.
-  // Figure out how to collect PV and change return.
+scored_move_t Search::aspirationSearch(SearchThread& t, int prevScore, int *researches) {
+  int maxScore = Search::SCORE_WIN + 101;
 
-  nodeCounter += 1;
+  int delta = FLAGS_aspiration_window;
+  int alpha = max(-maxScore, prevScore - delta);
+  int beta = min(maxScore, prevScore + delta);
 
-  if (globalStop) {
-    return make_pair(SCORE_INTERRUPT, Board::NULL_MOVE);
-  }
+  while (true) {
+    t.followPv = true;
+    scored_move_t test = findMoveHelper(t, 0, t.plySearchDepth, alpha, beta);
+    if (globalStop.load(memory_order_acquire) || test.first == SCORE_INTERRUPT) {
+      return make_pair(SCORE_INTERRUPT, Board::NULL_MOVE);
+    }
 
+    // Score is only a bound when outside the window, widen that side (more each time).
+    bool failLow = test.first <= alpha && alpha > -maxScore;
+    bool failHigh = test.first >= beta && beta < maxScore;
+    if (!failLow && !failHigh) {
+      return test;
+    }
 
-  if (FLAGS_use_ttable) {
-    TTableEntry* lookup = lookupTT(b.getZobrist());
-    if (lookup != nullptr) {
-      if (lookup->depth >= plyR) {
-        ttCounter += 1;
+    *researches += 1;
+    delta *= 2;
+    if (failLow) {
+      alpha = max(-maxScore, test.first - delta);
+    } else {
+      beta = min(maxScore, test.first + delta);
+    }
 
-        // TODO verify this is correct code cause I'm struggling at 3am.
-        if (lookup->type == LOWER_BOUND) {
-          alpha = max(alpha, lookup->score);
+    if (FLAGS_verbosity >= 3) {
+      cout << "\t\tply: " << t.plySearchDepth << " failed " << (failLow ? "low" : "high")
+           << " at " << test.first << " re-searching [" << alpha << ", " << beta << "]" << endl;
+    }
+  }
+}
 
-        } else if (lookup->type == UPPER_BOUND) {
-          beta = max(beta, lookup->score);
-        }
 
-        // TODO it seems like this can return outside the bounds which is not allowed? (fail hard?)
+void Search::helperSearch(SearchThread& t) {
+  int maxScore = Search::SCORE_WIN + 101;
 
-        // If we have the old exact score or are out of the search window return move.
-        if (alpha >= beta || lookup->type == EXACT_BOUND) {
-          return make_pair(lookup->score, lookup->suggested);
-        }
-      }
+  // Half the helpers start a ply ahead of main so threads don't all search the same depth.
+  for (t.plySearchDepth = 2 + (t.id % 2); t.plySearchDepth < MAX_PLY; t.plySearchDepth++) {
+    t.followPv = true;
+    scored_move_t test = findMoveHelper(t, 0, t.plySearchDepth, -maxScore, maxScore);
+    if (test.first == SCORE_INTERRUPT) {
+      break;
     }
+    savePv(t);
   }
+}
+
 
-  if (plyR == 0) {
-    return make_pair(quiesce(b, alpha, beta), b.getLastMove());
+void Search::savePv(SearchThread& t) {
+  t.prevPvLength = t.pvLength[0];
+  for (int i = 0; i < t.prevPvLength; i++) {
+    t.prevPv[i] = t.pv[0][i];
   }
+}
 
-  vector<Board> children = b.getLegalChildren();
-  if (children.empty()) {
-    // Node is end of game!
-    board_s status = b.getGameResult_slow();
-    int score = getGameResultScore(status, plySearchDepth - plyR);
 
-    // This might be possible if they load from FEN
-    assert( b.getLastMove() != Board::NULL_MOVE );
-    return make_pair(score, b.getLastMove());
+string Search::pvString(Board b, const vector<move_t>& pv) {
+  string line;
+  for (move_t move : pv) {
+    line += (line.empty() ? "" : " ") + b.algebraicNotation_slow(move);
+    b.makeMove(move);
+  }
+  return line;
+}
+
+
+scored_move_t Search::findMoveHelper(SearchThread& t, int ply, char plyR, int alpha, int beta) {
+  // Only the root's move is used, the rest of the line is collected in t.pv.
+
+  // Leaves are counted by quiesce.
+  if (plyR > 0) {
+    t.nodes.fetch_add(1, memory_order_relaxed);
+  }
+
+  if (t.id == 0 && ++t.timeCheckNodes >= TIME_CHECK_NODES) {
+    checkTime(t);
   }
 
-  if (plyR >= 1) {
-    // Take the time and try and order in some reasonable way.
-    orderChildren(children);
+  if (globalStop.load(memory_order_relaxed) || (t.id > 0 && helpersStop)) {
+    return make_pair(SCORE_INTERRUPT, Board::NULL_MOVE);
+  }
+
+  Board& b = t.b;
+  assert( ply < MAX_PLY );
+  t.pvLength[ply] = ply;
+
+  move_t hashMove = Board::NULL_MOVE;
+  if (FLAGS_use_ttable) {
+    TTableEntry lookup;
+    if (lookupTT(b.getZobrist(), &lookup)) {
+      hashMove = lookup.suggested;
+      lookup.score = scoreFromTT(lookup.score, ply);
+
+      // Never cut the root so there is always a move (and full pv).
+      if (lookup.depth >= plyR && ply > 0) {
+        t.ttHits.fetch_add(1, memory_order_relaxed);
+
+        // Old exact score or a bound that is already outside the search window.
+        if (lookup.type == EXACT_BOUND ||
+            (lookup.type == LOWER_BOUND && lookup.score >= beta) ||
+            (lookup.type == UPPER_BOUND && lookup.score <= alpha)) {
+          return make_pair(lookup.score, lookup.suggested);
+        }
+      }
+    }
+  }
+
+  if (plyR <= 0) {
+    return make_pair(quiesce(t, ply, alpha, beta), b.getLastMove());
   }
 
   bool isWhiteTurn = b.getIsWhiteTurn();
 
-  atomic<int>    bestIndex(-1);
-  atomic<int>    atomic_alpha(alpha);
-  atomic<int>    atomic_beta(beta);
-  atomic<bool>   shouldBreak(false);
+  // Last iteration's best line is searched first (the TT usually agrees).
+  bool onPv = t.followPv;
+  t.followPv = false;
+  bool inCheck = b.isInCheck();
+
+  // Null move pruning: if passing still fails high (from a shallower search) a real move will too.
+  // Not in check (passing would be illegal), not right after a null move, not on the PV and
+  // not with only pawns left where zugzwang (every move makes it worse) is common.
+  if (FLAGS_null_move_pruning && ply > 0 && !onPv && plyR >= 3 &&
+      b.getLastMove() != Board::NULL_MOVE && b.hasNonPawnMaterial() && !inCheck) {
+    int staticEval = b.heuristic();
+    if (isWhiteTurn ? staticEval >= beta : staticEval <= alpha) {
+      // Adaptive: reduce more when there is depth to spare.
+      int reduction = plyR > 6 ? 3 : 2;
+
+      UndoState undo;
+      b.makeNullMove(&undo);
+      // Zero width window just testing the bound.
+      int value = isWhiteTurn ?
+          findMoveHelper(t, ply + 1, plyR - 1 - reduction, beta - 1, beta).first :
+          findMoveHelper(t, ply + 1, plyR - 1 - reduction, alpha, alpha + 1).first;
+      b.unmakeNullMove(undo);
+
+      if (value == SCORE_INTERRUPT) {
+        return make_pair(SCORE_INTERRUPT, Board::NULL_MOVE);
+      }
 
-  #pragma omp parallel for if (!FLAGS_use_ttable)
-  for (int ci = 0; ci < children.size(); ci++) {
-    if (shouldBreak) {
-      continue;
+      t.nullMoveTries.fetch_add(1, memory_order_relaxed);
+      if (isWhiteTurn ? value >= beta : value <= alpha) {
+        t.nullMoveCutoffs.fetch_add(1, memory_order_relaxed);
+        return make_pair(isWhiteTurn ? beta : alpha, Board::NULL_MOVE);
+      }
     }
+  }
+  if (onPv && ply < t.prevPvLength) {
+    hashMove = t.prevPv[ply];
+  }
 
-    Board child = children[ci];
-    auto suggest = findMoveHelper(child, plyR - 1, atomic_alpha, atomic_beta);
+  // Moves are generated lazily in stages, most nodes cut-off before quiet moves are needed.
+  move_t lastMove = b.getLastMove();
+  MovePicker picker(
+      b, hashMove, t.killers[ply][0], t.killers[ply][1],
+      t.counterMoves[moveFrom(lastMove)][moveTo(lastMove)], &t.history);
+
+  move_t bestMove = Board::NULL_MOVE;
+  bool wasCutoff = false;
+  int searched = 0;
+  // Quiet moves that didn't cause a cut-off (lowered in history if a later one does).
+  MoveList quietsTried;
+
+  UndoState undo;
+  for (move_t move; !wasCutoff && (move = picker.nextMove()) != Board::NULL_MOVE; ) {
+    searched++;
+    t.followPv = onPv && move == hashMove;
+    bool isQuiet = moveCapture(move) == 0 && moveSpecial(move) != Board::SPECIAL_PROMOTION;
+    b.makeMove(move, &undo);
+
+    // Late move reductions: quiet moves this late in the ordering rarely beat the best so far,
+    // test that with a shallower zero width search and only search fully if they do.
+    int reduction = 0;
+    if (FLAGS_late_move_reductions && !onPv && !inCheck && plyR >= 3 && isQuiet &&
+        move != t.killers[ply][0] && move != t.killers[ply][1] && !b.isInCheck()) {
+      reduction = min(lateMoveReduction(plyR, searched), plyR - 2);
+    }
+
+    scored_move_t suggest;
+    if (reduction > 0) {
+      suggest = isWhiteTurn ?
+          findMoveHelper(t, ply + 1, plyR - 1 - reduction, alpha, alpha + 1) :
+          findMoveHelper(t, ply + 1, plyR - 1 - reduction, beta - 1, beta);
+      t.lmrReductions.fetch_add(1, memory_order_relaxed);
+
+      bool improved = isWhiteTurn ? suggest.first > alpha : suggest.first < beta;
+      if (improved && suggest.first != SCORE_INTERRUPT) {
+        t.lmrResearches.fetch_add(1, memory_order_relaxed);
+        reduction = 0;
+      }
+    }
+    if (reduction == 0) {
+      suggest = findMoveHelper(t, ply + 1, plyR - 1, alpha, beta);
+    }
+
+    b.unmakeMove(move, undo);
+    t.followPv = false;
     int value = suggest.first;
 
     if (value == SCORE_INTERRUPT) {
-      shouldBreak = true;
+      return suggest;
     }
 
-    // History Heuristic not sure if it adds value.
-    //auto lastMove = child.getLastMove();
-    //int fromS = (get<0>(lastMove) << 3) + get<1>(lastMove);
-    //int toS = (get<2>(lastMove) << 3) + get<3>(lastMove);
+    bool improved = isWhiteTurn ? value > alpha : value < beta;
+    if (!improved) {
+      if (isQuiet) {
+        quietsTried.push_back(move);
+      }
+      continue;
+    }
+
+    bestMove = move;
+
+    // This move followed by the child's line.
+    t.pv[ply][ply] = move;
+    for (int i = ply + 1; i < t.pvLength[ply + 1]; i++) {
+      t.pv[ply][i] = t.pv[ply + 1][i];
+    }
+    t.pvLength[ply] = max(ply + 1, t.pvLength[ply + 1]);
 
     if (isWhiteTurn) {
-      if (value > atomic_alpha) {
-        bestIndex = ci;
-        atomic_alpha = value;
-        if (atomic_alpha >= atomic_beta) {
-          // Beta cut-off  (Opp won't pick this brach because we can do too well)
-          //updateHistory(isWhiteTurn, fromS, toS, 1 << plyR);
-
-          shouldBreak = true;
-        }
+      alpha = value;
+      if (alpha >= beta) {
+        // Beta cut-off  (Opp won't pick this brach because we can do too well)
+        updateMoveOrdering(t, ply, plyR, move, quietsTried);
+
+        wasCutoff = true;
       }
     } else {
-      if (value < atomic_beta) {
-        bestIndex = ci;
-        atomic_beta = value;
-        if (atomic_beta <= atomic_alpha) {
-          // Alpha cut-off  (We have a strong defense so opp will play older better branch)
-          //updateHistory(isWhiteTurn, fromS, toS, 1 << plyR);
-
-          shouldBreak = true;
-        }
+      beta = value;
+      if (beta <= alpha) {
+        // Alpha cut-off  (We have a strong defense so opp will play older better branch)
+        updateMoveOrdering(t, ply, plyR, move, quietsTried);
+
+        wasCutoff = true;
       }
     }
   }
 
-  if (globalStop) {
-    return make_pair(SCORE_INTERRUPT, Board::NULL_MOVE);
-  }
+  if (searched == 0) {
+    // Passing can leave the other side without moves, that isn't a stalemate (they weren't
+    // allowed to pass) so fail without a null move cut-off.
+    if (ply > 0 && b.getLastMove() == Board::NULL_MOVE) {
+      return make_pair(isWhiteTurn ? beta : alpha, Board::NULL_MOVE);
+    }
+
+    // Node is end of game!
+    board_s status = b.getGameResult_slow();
+    int score = getGameResultScore(status, ply);
 
-  // Black found a position with score < alpha (strong position for black with black to move).
-  // White won't choose to play this path, will instead play whatever path had score > alpha.
-  // Score is an hence an upperbound (as black didn't finish the search).
-  bool wasAlphaCutoff = shouldBreak && !isWhiteTurn;
+    // This might be possible if they load from FEN
+    assert( b.getLastMove() != Board::NULL_MOVE );
+    return make_pair(score, b.getLastMove());
+  }
 
-  // Found position > beta (strong position for white with white to move).
-  // Black won't choose to play this path, will instead play whatever path had score < beta.
-  // Score is an hence an lowerbound (as white didn't finish the search).
-  bool wasBetaCutoff  = shouldBreak && isWhiteTurn;
+  if (globalStop.load(memory_order_relaxed)) {
+    return make_pair(SCORE_INTERRUPT, Board::NULL_MOVE);
+  }
 
-  int bestInGen = isWhiteTurn ? atomic_alpha : atomic_beta;
+  int bestInGen = isWhiteTurn ? alpha : beta;
   //assert( alpha <= bestInGen && bestInGen <= beta );
 
-  // TODO figure out why people want me to store refuting move (later searches maybe?)
-  move_t suggestion = (wasAlphaCutoff || wasBetaCutoff) ?
-      Board::NULL_MOVE : children[bestIndex].getLastMove();
+  if (FLAGS_use_ttable) {
+    // Black found a position with score <= alpha (strong position for black with black to move).
+    // White won't choose to play this path, will instead play whatever path had score > alpha.
+    // Score is an hence an upperbound (as black didn't finish the search).
+    // Same if white didn't find anything better than alpha.
+    bool isUpperBound = isWhiteTurn ? bestMove == Board::NULL_MOVE : wasCutoff;
+
+    // Found position >= beta (strong position for white with white to move), lowerbound.
+    bool isLowerBound = isWhiteTurn ? wasCutoff : bestMove == Board::NULL_MOVE;
 
-  if (FLAGS_use_ttable && plyR >= 0) {
-    char ttType = wasAlphaCutoff ? UPPER_BOUND :
-        (wasBetaCutoff ? LOWER_BOUND : EXACT_BOUND);
+    char ttType = isUpperBound ? UPPER_BOUND : (isLowerBound ? LOWER_BOUND : EXACT_BOUND);
 
-    TTableEntry *entry = new TTableEntry{ttType, plyR /* depth */, bestInGen, suggestion};
-    storeTT(b.getZobrist(), entry);
+    // Best (or refuting) move, else keep the old hash move for ordering.
+    move_t suggestion = bestMove != Board::NULL_MOVE ? bestMove : hashMove;
+    storeTT(b.getZobrist(),
+            TTableEntry{ttType, plyR /* depth */, scoreToTT(bestInGen, ply), suggestion});
   }
 
-  return make_pair(bestInGen, suggestion);
+  return make_pair(bestInGen, bestMove);
 }
 
 
-int Search::quiesce(const Board& b, int alpha, int beta) {
-  //quiesceCounter += 1;
-  // TODO more implementations here eventually.
+int Search::quiesce(SearchThread& t, int ply, int alpha, int beta) {
+  t.quiesceNodes.fetch_add(1, memory_order_relaxed);
+  if (t.id == 0 && ++t.timeCheckNodes >= TIME_CHECK_NODES) {
+    checkTime(t);
+  }
 
-  int score = b.heuristic();
+  Board& b = t.b;
+  bool isWhiteTurn = b.getIsWhiteTurn();
+  bool inCheck = b.isInCheck();
 
-  return min(beta, max(alpha, score));
+  // Stand pat: side to move can (most likely) do at least as well as not capturing.
+  // Not when in check, then every evasion is searched.
+  int standPat = b.heuristic();
+  if (!inCheck) {
+    if (isWhiteTurn) {
+      if (standPat >= beta) {
+        return beta;
+      }
+      alpha = max(alpha, standPat);
+    } else {
+      if (standPat <= alpha) {
+        return alpha;
+      }
+      beta = min(beta, standPat);
+    }
+  }
+
+  MovePicker picker = inCheck ?
+      MovePicker(b, Board::NULL_MOVE, Board::NULL_MOVE, Board::NULL_MOVE, Board::NULL_MOVE,
+                 &t.history) :
+      MovePicker(b);
+
+  int searched = 0;
+  UndoState undo;
+  for (move_t move; (move = picker.nextMove()) != Board::NULL_MOVE; ) {
+    searched++;
+
+    if (!inCheck) {
+      // Delta pruning: even winning this piece (and promoting) can't reach the window.
+      board_s captured = moveCapture(move);
+      int gain = captured ? abs(Board::getPieceValue(captured)) : 0;
+      if (moveSpecial(move) == Board::SPECIAL_PROMOTION) {
+        gain += abs(Board::getPieceValue(movePiece(move))) - Board::getPieceValue(Board::PAWN);
+      }
+
+      if (isWhiteTurn ? (standPat + gain + QUIESCE_DELTA <= alpha) :
+                        (standPat - gain - QUIESCE_DELTA >= beta)) {
+        continue;
+      }
+    }
+
+    b.makeMove(move, &undo);
+    int value = quiesce(t, ply + 1, alpha, beta);
+    b.unmakeMove(move, undo);
+
+    if (isWhiteTurn) {
+      alpha = max(alpha, value);
+      if (alpha >= beta) {
+        return beta;
+      }
+    } else {
+      beta = min(beta, value);
+      if (beta <= alpha) {
+        return alpha;
+      }
+    }
+  }
+
+  if (inCheck && searched == 0) {
+    int score = getGameResultScore(
+        isWhiteTurn ? Board::RESULT_BLACK_WIN : Board::RESULT_WHITE_WIN, ply);
+    return min(beta, max(alpha, score));
+  }
+
+  return isWhiteTurn ? alpha : beta;
 }
 
 
@@ -501,6 +944,28 @@ int Search::getGameResultScore(board_s gameResult, int depth) {
 }
 
 
+int Search::scoreToTT(int score, int ply) {
+  if (score >= Search::SCORE_WIN) {
+    return score + ply;
+  }
+  if (score <= -Search::SCORE_WIN) {
+    return score - ply;
+  }
+  return score;
+}
+
+
+int Search::scoreFromTT(int score, int ply) {
+  if (score >= Search::SCORE_WIN) {
+    return score - ply;
+  }
+  if (score <= -Search::SCORE_WIN) {
+    return score + ply;
+  }
+  return score;
+}
+
+
 string Search::scoreString(int score) {
   if (abs(score) > Search::SCORE_WIN) {
     int depth = Search::SCORE_WIN + 100 - abs(score);
@@ -510,37 +975,135 @@ string Search::scoreString(int score) {
 }
 
 
-void Search::perft(
-    const Board& b,
-    int ply,
-    atomic<long> *count,
-    atomic<long> *captures,
-    atomic<int> *ep,
-    atomic<int> *castles,
-    atomic<int> *promotions,
-    atomic<int> *mates) {
+void PerftCounts::add(const PerftCounts& other) {
+  nodes += other.nodes;
+  captures += other.captures;
+  ep += other.ep;
+  castles += other.castles;
+  promotions += other.promotions;
+  checks += other.checks;
+  mates += other.mates;
+}
+
+
+PerftCounts Search::perft(
+    const Board& b, int ply, bool categories, vector<perft_divide_t> *divide) {
+  PerftCounts total;
+  if (divide) {
+    divide->clear();
+  }
+
   if (ply == 0) {
-    move_t move = b.getLastMove();
-    board_s moveSpecial = get<6>(move);
+    Board leaf = b;
+    perftHelper(leaf, ply, categories, &total);
+    return total;
+  }
+
+  MoveList moves = b.getLegalMoves();
+
+  // All tasks are created before any start so their counts never move.
+  vector<PerftCounts> rootCounts(moves.size());
+  vector<PerftTask> tasks;
+  for (int mi = 0; mi < moves.size(); mi++) {
+    PerftTask task;
+    task.rootIndex = mi;
+    task.b = b;
+    task.b.makeMove(moves[mi]);
+    task.ply = ply - 1;
+    task.categories = categories;
+    tasks.push_back(task);
+  }
+
+  // Every task has the same plies left, expand them all till there are enough to share out.
+  size_t wanted = PERFT_TASKS_PER_THREAD * globalPool().size();
+  while (tasks.size() < wanted && !tasks.empty() && tasks[0].ply > 1) {
+    vector<PerftTask> expanded;
+    for (const PerftTask& task : tasks) {
+      for (move_t move : task.b.getLegalMoves()) {
+        PerftTask child = task;
+        child.b.makeMove(move);
+        child.ply -= 1;
+        expanded.push_back(child);
+      }
+    }
+    tasks.swap(expanded);
+  }
+
+  TaskGroup group(globalPool());
+  for (PerftTask& task : tasks) {
+    PerftTask *t = &task;
+    group.run([t]() { perftHelper(t->b, t->ply, t->categories, &t->counts); });
+  }
+  group.wait();
+
+  for (const PerftTask& task : tasks) {
+    rootCounts[task.rootIndex].add(task.counts);
+  }
+  for (int mi = 0; mi < moves.size(); mi++) {
+    total.add(rootCounts[mi]);
+    if (divide) {
+      divide->push_back(make_pair(moves[mi], rootCounts[mi]));
+    }
+  }
+  return total;
+}
 
-    count->fetch_add(1);
-//    board_hash_t test = zobrist;
-//    assert( test == getZobrist_slow() );
 
-    if (get<5>(move) != 0) { captures->fetch_add(1); }
-    if (moveSpecial == Board::SPECIAL_EN_PASSANT) { ep->fetch_add(1); }
-    if (moveSpecial == Board::SPECIAL_CASTLE) { castles->fetch_add(1); }
-    if (moveSpecial == Board::SPECIAL_PROMOTION) { promotions->fetch_add(1); }
+void Search::perftHelper(Board& b, int ply, bool categories, PerftCounts *counts) {
+  if (ply == 0) {
+    // Only reached for perft(b, 0), otherwise leaves are counted one ply up.
+    move_t move = b.getLastMove();
+    board_s special = moveSpecial(move);
+
+    counts->nodes += 1;
+    if (categories && move != Board::NULL_MOVE) {
+      if (moveCapture(move) != 0) { counts->captures += 1; }
+      if (special == Board::SPECIAL_EN_PASSANT) { counts->ep += 1; }
+      if (special == Board::SPECIAL_CASTLE) { counts->castles += 1; }
+      if (special == Board::SPECIAL_PROMOTION) { counts->promotions += 1; }
+      if (b.isInCheck()) {
+        counts->checks += 1;
+        if (b.getLegalMoves().empty()) { counts->mates += 1; }
+      }
+    }
+    return;
+  }
 
+  MoveList moves = b.getLegalMoves();
+
+  if (ply == 1) {
+    if (categories) {
+      perftLeaves(b, moves, counts);
+    } else {
+      counts->nodes += moves.size();
+    }
     return;
   }
 
-  vector<Board> children = b.getLegalChildren();
-  // TODO This incorrectly counts stalemates.
-  if (children.size() == 0) { mates->fetch_add(1); }
+  UndoState undo;
+  for (move_t move : moves) {
+    b.makeMove(move, &undo);
+    perftHelper(b, ply - 1, categories, counts);
+    b.unmakeMove(move, undo);
+  }
+}
+
 
-  #pragma omp parallel for
-  for (int ci = 0; ci < children.size(); ci++) {
-    perft(children[ci], ply - 1, count, captures, ep, castles, promotions, mates);
+void Search::perftLeaves(const Board& b, const MoveList& moves, PerftCounts *counts) {
+  counts->nodes += moves.size();
+  for (move_t move : moves) {
+    board_s special = moveSpecial(move);
+    if (moveCapture(move) != 0) { counts->captures += 1; }
+    if (special == Board::SPECIAL_EN_PASSANT) { counts->ep += 1; }
+    if (special == Board::SPECIAL_CASTLE) { counts->castles += 1; }
+    if (special == Board::SPECIAL_PROMOTION) { counts->promotions += 1; }
+    if (b.givesCheck(move)) {
+      counts->checks += 1;
+
+      // Only a check can be mate, so only those children are made.
+      Board child = b;
+      child.makeMove(move);
+      if (child.getLegalMoves().empty()) { counts->mates += 1; }
+    }
   }
 }
@@ -3,13 +3,16 @@
 
 #include <atomic>
 #include <map>
-#include <random>
+#include <memory>
 #include <string>
 #include <tuple>
 #include <utility>
 #include <vector>
 
 #include "flags.h"
+#include "movepick.h"
+#include "threadpool.h"
+#include "timeman.h"
 
 using namespace std;
 using namespace board;
@@ -18,24 +21,105 @@ namespace search {
   // score concatonated to end of move_t
   typedef pair<int, move_t> scored_move_t;
 
+  // Deepest ply (from root) with killer moves.
+  const int MAX_PLY = 64;
+  // Late move reductions are the same for every move after this many.
+  const int LMR_MAX_MOVES = 64;
+  // The main thread looks at the clock once per this many nodes (search + quiesce).
+  const int TIME_CHECK_NODES = 1024;
+
+  // Leaf (depth 0) positions by how they were reached, mates are leaves that are checkmate.
+  struct PerftCounts {
+    long nodes;
+    long captures;
+    long ep;
+    long castles;
+    long promotions;
+    long checks;
+    long mates;
+
+    PerftCounts() :
+      nodes(0), captures(0), ep(0), castles(0), promotions(0), checks(0), mates(0) {}
+    void add(const PerftCounts& other);
+  };
+
+  // Perft counts under one root move.
+  typedef pair<move_t, PerftCounts> perft_divide_t;
+
+  // Perft expands the root a ply at a time till there are this many tasks per pool thread (each
+  // task then counts its whole subtree).
+  const int PERFT_TASKS_PER_THREAD = 16;
+
+  // Everything one search thread changes, threads only share the transposition table.
+  struct SearchThread {
+    // 0 is the main thread (its result is played), others are Lazy SMP helpers.
+    int id;
+    // Searched in place (makeMove / unmakeMove).
+    Board b;
+    int plySearchDepth;
+
+    // Read by the main thread while searching.
+    atomic<long> nodes;
+    atomic<long> quiesceNodes;
+    atomic<long> ttHits;
+    atomic<long> nullMoveTries;
+    atomic<long> nullMoveCutoffs;
+    // Reduced searches and how many of those had to be searched again at full depth.
+    atomic<long> lmrReductions;
+    atomic<long> lmrResearches;
+    // Nodes since the main thread last looked at the clock.
+    int timeCheckNodes;
+
+    // Move ordering, only touched by this thread.
+    // Two most recent quiet cut-off moves per ply from root.
+    move_t killers[MAX_PLY][2];
+    // Last quiet move that refuted [from][to] of the previous move.
+    move_t counterMoves[64][64];
+    HistoryTable history;
+
+    // Triangular PV table, pv[ply] is the best line found from ply (to pvLength[ply]).
+    move_t pv[MAX_PLY][MAX_PLY];
+    int pvLength[MAX_PLY];
+
+    // PV of the last finished iteration, searched first by the next one.
+    move_t prevPv[MAX_PLY];
+    int prevPvLength;
+    // Is the current node on prevPv.
+    bool followPv;
+
+    // Clears everything but id and move ordering for a new search from root.
+    void reset(const Board& root);
+  };
+
   // Search Class
   class Search {
     // Game result scores
     static const int SCORE_WIN          = 10000;
     static const int SCORE_INTERRUPT    = 22222; // Importantly outside search window.
 
+    // Captures that can't bring the score within this of alpha (beta) aren't searched.
+    static const int QUIESCE_DELTA      = 200;
+
     public:
       // Constructors
       Search(bool withTimeControl);
       Search(Board root, bool withTimeContol);
+      ~Search();
 
       // Gets and Setters
+      // The game position (not the position being pondered).
       Board const getRoot();
       void makeMove(move_t move);
       bool makeAlgebraicMove(string move);
       void updateTime(long wTime, long bTime);
-      long getTimeForMove_millis();
       static string scoreString(int score);
+      // Algebraic names of the moves in pv played from b.
+      static string pvString(Board b, const vector<move_t>& pv);
+
+      // VisibleForTesting: searches the root as a (non PV) node ply deep in a search, with a new
+      // helper thread. nullMoveTries gets how often null move pruning was tried.
+      scored_move_t searchNodeForTesting(
+          int ply, int plyR, int alpha, int beta, long *nullMoveTries);
 
       // Misc.
       void save();
@@ -44,35 +128,85 @@ namespace search {
       // Expensive calls
       scored_move_t findMove(int minPly, int minNodes, FindMoveStats *info);
 
-      static void perft(
-          const Board&b,
-          int ply,
-          atomic<long> *count,
-          atomic<long> *captures,
-          atomic<int> *ep,
-          atomic<int> *castles,
-          atomic<int> *promotions,
-          atomic<int> *mates);
+      // Searches the position after move and the expected reply in the background (without a time
+      // limit) till the game plays something else. If both are played the next findMove continues
+      // this search instead of starting over.
+      void startPonder(move_t move, move_t reply, int minPly, int minNodes);
+      // Stops and throws away the ponder search (if any).
+      void stopPonder();
+
+      // Splits the tree into thread pool tasks (see PERFT_TASKS_PER_THREAD) that count into
+      // their own PerftCounts, summed once all are done. divide (if given) gets the counts per
+      // root move.
+      // Leaves are counted from the last ply's move list, categories (everything but nodes) are
+      // only counted if asked for. Only checking moves are made (to look for mate).
+      static PerftCounts perft(
+          const Board& b, int ply, bool categories, vector<perft_divide_t> *divide);
 
     private:
       void setup();
 
+      // One perft task, b is below root move rootIndex with ply plies left.
+      struct PerftTask {
+        int rootIndex;
+        Board b;
+        int ply;
+        bool categories;
+        PerftCounts counts;
+      };
+
+      // Counts b's subtree in place (makeMove / unmakeMove).
+      static void perftHelper(Board& b, int ply, bool categories, PerftCounts *counts);
+      // Leaves below b (one ply), by flag checks on the moves.
+      static void perftLeaves(const Board& b, const MoveList& moves, PerftCounts *counts);
+
       // Helper methods.
-      static void orderChildren(vector<Board> &children);
-      static int moveOrderingValue(const Board& b);
+      static void clearMoveOrdering(SearchThread& t);
+      // Between moves of a game: killers are cleared (their plies changed), history is aged and
+      // counter moves are kept.
+      static void ageMoveOrdering(SearchThread& t);
+      // Killers, counter move and history after move caused a cut-off ply moves from the root,
+      // quietsTried were searched before it (and didn't).
+      static void updateMoveOrdering(
+          SearchThread& t, int ply, char plyR, move_t move, const MoveList& quietsTried);
       static int getGameResultScore(board_s gameResult, int depth);
+      // Mate scores are stored in the TT relative to the node (not root) so they stay correct
+      // when reached from a different ply or a later move.
+      static int scoreToTT(int score, int ply);
+      static int scoreFromTT(int score, int ply);
+      // Monotonic, only differences are meaningful.
       static long getCurrentTime_millis();
 
-      void stopAfterAllocatedTime(int searchEndTime);
+      // True if move was the next expected ponder move, otherwise the ponder search is stopped.
+      bool confirmPonderMove(move_t move);
+
+      // Sets globalStop once past hardStopTime, called by the main thread every TIME_CHECK_NODES.
+      void checkTime(SearchThread& t);
 
       // 1-arg version is public.
       scored_move_t findMoveInner(int minPly, int minNodes, FindMoveStats *info);
-      scored_move_t findMoveHelper(const Board& b, char ply, int alpha, int beta);
+      // Root search in a window around prevScore (see --aspiration_window), re-searched with a
+      // wider window till the score is inside it.
+      scored_move_t aspirationSearch(SearchThread& t, int prevScore, int *researches);
+      // Lazy SMP helper, iterative deepening (staggered from main) till helpersStop.
+      void helperSearch(SearchThread& t);
+      // Copies the finished iteration's pv to prevPv.
+      static void savePv(SearchThread& t);
+      // Searches t.b in place (makeMove / unmakeMove), t.b is unchanged on return.
+      // ply is moves from the root, plyR is the remaining depth.
+      scored_move_t findMoveHelper(SearchThread& t, int ply, char plyR, int alpha, int beta);
+
+      // Plies to reduce the moveNumber-th (1 indexed) move searched with plyR remaining.
+      int lateMoveReduction(int plyR, int moveNumber) const;
+
+      // Sum over all search threads.
+      long totalNodes();
+      long totalTTHits();
 
       // Quiesce is a search at a leaf node which tries to avoid the horizon effect
       //   (if Queen just captured pawn make sure the queen can't be recaptured)
-      static int quiesce(const Board& b, int alpha, int beta);
-      static int evalCaptures(const Board& b, int alpha, int beta, int depth);
+      // Only captures and promotions (all evasions when in check) are searched, ply is from root.
+      int quiesce(SearchThread& t, int ply, int alpha, int beta);
 
       // Variables
       // Board state
@@ -81,23 +215,34 @@ namespace search {
       Board root;
 
       // Global search state
-      int plySearchDepth;
-      atomic<int> nodeCounter;
-      atomic<int> quiesceCounter;
-      atomic<int> ttCounter;
+      // threads[0] is the main thread, see --threads.
+      vector<unique_ptr<SearchThread>> threads;
+      atomic<bool> helpersStop;
+
+      // [plyR][moveNumber] see --lmr_base, --lmr_divisor and --lmr_min_moves.
+      int lmrTable[MAX_PLY][LMR_MAX_MOVES];
+
+      // Pondering, root is ponderBase + ponderMoves while ponderTask runs.
+      unique_ptr<threadpool::TaskGroup> ponderTask;
+      Board ponderBase;
+      vector<move_t> ponderMoves;
+      // How many of ponderMoves have been played (and applied to ponderBase).
+      size_t ponderConfirmed;
+      // Ponder searches don't stop on minNodes till the reply is played.
+      atomic<bool> pondering;
+      scored_move_t ponderResult;
+      FindMoveStats ponderStats;
 
       // Timing related vars
       bool useTimeControl;
-      long wMaxTime, bMaxTime;
       long wCurrentTime, bCurrentTime;
       long searchStartTime;
-      bool globalStop;
-
-      // Extra stuff!
-      default_random_engine generator;
-
-      // Seems to have the right shape.
-      gamma_distribution<double> move_time_dist;
+      // Only used by the thread running iterative deepening once the search is time limited.
+      TimeManager timeManager;
+      // Deadline (getCurrentTime_millis) of the current search, 0 while there is no limit.
+      atomic<long> hardStopTime;
+      // Written with release and read with acquire outside of the tree (relaxed inside it).
+      atomic<bool> globalStop;
   };
 }
 #endif // SEARCH_H
@@ -21,7 +21,7 @@ Search * searchT;
 string suggest(long wTime, long bTime) {
   searchT->updateTime(wTime, bTime);
 
-  FindMoveStats stats = {0, 0};
+  FindMoveStats stats = {0, 0, 0};
   scored_move_t suggest = searchT->findMove(
       FLAGS_server_min_ply,
       FLAGS_server_min_nodes,
@@ -34,7 +34,14 @@ string suggest(long wTime, long bTime) {
 
   cout << "Got suggested Move: " << alg << " (raw: " << coords << ")"
        << " score: " << Search::scoreString(score)
-       << " (searched " << stats.plyR << " plyR and " << stats.nodes << " nodes)" << endl;
+       << " (searched " << stats.plyR << " plyR and " << stats.nodes << " nodes)" << endl
+       << "\tpv: " << Search::pvString(searchT->getRoot(), stats.pv) << endl;
+
+  // Think about the expected reply while the opponent does.
+  if (FLAGS_server_ponder && stats.pv.size() >= 2 && stats.pv[0] == move) {
+    cout << "Pondering: " << Search::pvString(searchT->getRoot(), {move, stats.pv[1]}) << endl;
+    searchT->startPonder(move, stats.pv[1], FLAGS_server_min_ply, FLAGS_server_min_nodes);
+  }
   return coords;
 }
 
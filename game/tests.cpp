@@ -1,21 +1,29 @@
+#include <algorithm>
 #include <atomic>
 #include <cassert>
 #include <chrono>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <iterator>
 #include <sstream>
 #include <string>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <utility>
 
 #include "board.h"
+#include "perft.h"
 #include "polyglot.h"
 #include "search.h"
+#include "threadpool.h"
 #include "flags.h"
 
 using namespace std;
 using namespace board;
 using namespace search;
+using namespace threadpool;
 
 Board boardAfterMoves(string stringOfMoves) {
   Board b;
@@ -58,6 +66,20 @@ bool verifyUpdates() {
     //cout << "eval: " << b.heuristic() << endl << endl << endl;
     for (auto c : b.getLegalChildren()) {
       for (auto d : c.getLegalChildren()) {
+        // Staged generation (captures then quiets) should cover each legal move once.
+        MoveList all = d.getLegalMoves();
+        MoveList captures = d.getLegalMoves(Board::GEN_CAPTURES);
+        MoveList quiets = d.getLegalMoves(Board::GEN_QUIETS);
+        assert( captures.size() + quiets.size() == all.size() );
+        for (move_t move : all) {
+          assert( d.isLegalMove(move) );
+          assert( count(captures.begin(), captures.end(), move) +
+                  count(quiets.begin(), quiets.end(), move) == 1 );
+        }
+        for (move_t move : b.getLegalMoves()) {
+          assert( d.isLegalMove(move) == (count(all.begin(), all.end(), move) == 1) );
+        }
+
         for (auto e : d.getLegalChildren()) {
           // Verify makeMove in a couple of ways.
           Board test = a.copy();
@@ -68,6 +90,26 @@ bool verifyUpdates() {
 
           assertEqualBoardState(e, test);
 
+          // Verify unmakeMove restores everything makeMove changed.
+          UndoState undo;
+          Board inPlace = d.copy();
+          inPlace.makeMove(e.getLastMove(), &undo);
+          assertEqualBoardState(e, inPlace);
+          inPlace.unmakeMove(e.getLastMove(), undo);
+          assertEqualBoardState(d, inPlace);
+          assert( inPlace.getLastMove() == d.getLastMove() );
+          assert( inPlace.generateFen_slow() == d.generateFen_slow() );
+          inPlace.recalculateEvaluations_slow();
+
+          // Same for passing the turn.
+          inPlace.makeNullMove(&undo);
+          assert( inPlace.getIsWhiteTurn() != d.getIsWhiteTurn() );
+          assert( inPlace.getLastMove() == Board::NULL_MOVE );
+          inPlace.recalculateZobrist_slow();
+          inPlace.unmakeNullMove(undo);
+          assertEqualBoardState(d, inPlace);
+          assert( inPlace.generateFen_slow() == d.generateFen_slow() );
+
           // Call the verify update methods.
           e.recalculateEvaluations_slow();
           e.recalculateZobrist_slow();
@@ -78,7 +120,8 @@ bool verifyUpdates() {
       }
     }
   }
-};
+  return true;
+}
 
 
 bool verifySeriesOfMoves(string stringOfMoves, string fen, board_hash_t zobrist) {
@@ -113,6 +156,42 @@ bool verifyEndGame(string stringOfMoves, board_s result) {
 }
 
 
+bool verifyStaticExchange(string fen, string moveName, int expected) {
+  Board b(fen);
+  for (move_t move : b.getLegalMoves()) {
+    if (b.algebraicNotation_slow(move) == moveName) {
+      int test = b.staticExchange(move);
+      if (test != expected) {
+        cout << "SEE " << moveName << " expected: " << expected << " was " << test << endl;
+      }
+      return test == expected;
+    }
+  }
+
+  cout << "SEE " << moveName << " not legal in " << fen << endl;
+  return false;
+}
+
+
+bool verifyNullMoveNoMoves(void) {
+  // Black (boxed in king, blocked pawns) has no moves once white passes.
+  // Null moves aren't tried right after a null move (or a fen's missing last move).
+  Board b("k7/p1K5/P7/8/6p1/8/6P1/6N1 b - - 0 1");
+  bool valid = b.makeAlgebraicMove_slow("g3");
+  assert( valid );
+  Search s(b, false /* useTimeControl */);
+
+  // Not on the PV and white is far ahead of the window, null move pruning is tried.
+  long nullMoveTries = 0;
+  int score = s.searchNodeForTesting(2, 5, 0, 1, &nullMoveTries).first;
+  bool passed = nullMoveTries > 0 && score >= 1;
+  if (!passed) {
+    cout << "Null move no moves: tries " << nullMoveTries << " score " << score << endl;
+  }
+  return passed;
+}
+
+
 void perft(int ply, map<int, long> countToVerify, string fen) {
   Board b;
   if (!fen.empty()) {
@@ -124,27 +203,32 @@ void perft(int ply, map<int, long> countToVerify, string fen) {
 
   auto T0 = chrono::system_clock().now();
 
-  atomic<long> count(0);
-  atomic<long> captures(0);
-  atomic<int> ep(0);
-  atomic<int> castles(0);
-  atomic<int> promotions(0);
-  atomic<int> mates(0);
-  Search::perft(b, ply, &count, &captures, &ep, &castles, &promotions, &mates);
+  vector<perft_divide_t> divide;
+  PerftCounts counts = Search::perft(b, ply, true /* categories */, &divide);
+  long count = counts.nodes;
 
   auto T1 = chrono::system_clock().now();
   chrono::duration<double> duration = T1 - T0;
   double duration_s = duration.count();
 
+  if (FLAGS_verbosity >= 1) {
+    for (auto& rootMove : divide) {
+      cout << "\t" << b.algebraicNotation_slow(rootMove.first) << ": "
+           << rootMove.second.nodes << endl;
+    }
+  }
+
   cout << "Perft results for" <<
           " depth (ply): " << ply << endl;
   cout << "\tcount: " << count <<
-          "\tcaptures: " << captures <<
-          "\ten passant: " << ep <<
-          "\tcastles: " << castles <<
-          "\tpromotions: " << promotions <<
-          "\tmates: " << mates << endl;
-  printf("\tevaled: %.0f knodes/s (%.2f seconds)\n", (count / duration_s / 1000), duration_s);
+          "\tcaptures: " << counts.captures <<
+          "\ten passant: " << counts.ep <<
+          "\tcastles: " << counts.castles <<
+          "\tpromotions: " << counts.promotions <<
+          "\tchecks: " << counts.checks <<
+          "\tmates: " << counts.mates << endl;
+  printf("\tevaled: %.0f knodes/s (%.2f seconds, %d threads)\n",
+      (count / duration_s / 1000), duration_s, globalPool().size());
 
   long expected = countToVerify[ply];
   if (expected > 0 && expected != count) {
@@ -156,6 +240,108 @@ void perft(int ply, map<int, long> countToVerify, string fen) {
 }
 
 
+// Leaf categories (from the move flags) against the published tables, and the bulk count.
+void verifyPerftCategories(
+    int ply, long nodes, long captures, long ep, long castles, long promotions, long checks,
+    long mates, string fen) {
+  Board b = fen.empty() ? Board() : Board(fen);
+
+  PerftCounts counts = Search::perft(b, ply, true /* categories */, nullptr);
+  PerftCounts bulk = Search::perft(b, ply, false /* categories */, nullptr);
+  cout << "Perft categories depth (ply): " << ply << "\tcount: " << counts.nodes
+       << "\tchecks: " << counts.checks << "\tmates: " << counts.mates << endl;
+
+  assert( counts.nodes == nodes );
+  assert( counts.captures == captures );
+  assert( counts.ep == ep );
+  assert( counts.castles == castles );
+  assert( counts.promotions == promotions );
+  assert( counts.checks == checks );
+  assert( counts.mates == mates );
+  assert( bulk.nodes == nodes );
+}
+
+
+void verifyPerftHashed(int ply, long expected, string fen) {
+  Board b = fen.empty() ? Board() : Board(fen);
+  PerftCache cache(FLAGS_perft_cache_mb);
+
+  auto T0 = chrono::system_clock().now();
+  long count = search::perftHashed(b, ply, &cache);
+  auto T1 = chrono::system_clock().now();
+  chrono::duration<double> hashedDuration = T1 - T0;
+
+  // Unique positions 3 plies deep, then hashed perft (fresh cache) from each of them.
+  PerftCache frontierCache(FLAGS_perft_cache_mb);
+  long frontierCount = perftFrontier(b, ply, min(ply, 3), &frontierCache);
+  auto T2 = chrono::system_clock().now();
+  chrono::duration<double> frontierDuration = T2 - T1;
+
+  cout << "Hashed perft depth (ply): " << ply << "\tcount: " << count
+       << " (" << hashedDuration.count() << " seconds), from frontier: " << frontierCount
+       << " (" << frontierDuration.count() << " seconds)" << endl;
+  assert( count == expected );
+  assert( frontierCount == expected );
+}
+
+
+// packPosition / unpackPosition against the FEN versions for every position ply deep.
+void verifyPackPosition(int ply, string fen) {
+  Board b = fen.empty() ? Board() : Board(fen);
+  for (FrontierEntry& entry : uniqueFrontier(b, ply, nullptr)) {
+    PackedPosition packed = packPosition(entry.b, entry.multiplicity);
+    PackedPosition packedSlow = packPosition_slow(entry.b, entry.multiplicity);
+    assert( memcmp(&packed, &packedSlow, sizeof(PackedPosition)) == 0 );
+
+    Board unpacked = unpackPosition(packed);
+    assert( unpacked.generateFen_slow() == unpackPosition_slow(packed).generateFen_slow() );
+    assert( unpacked.getZobrist() == entry.b.getZobrist() );
+  }
+}
+
+
+void verifyDiskPerft(int ply, long expected, size_t runRecords, string fen) {
+  char dir[] = "/tmp/betachess-perft-XXXXXX";
+  char *made = mkdtemp(dir);
+  assert( made != nullptr );
+
+  long count = diskPerft(fen, ply, dir, runRecords);
+  cout << "Disk perft depth (ply): " << ply << "\tcount: " << count << endl;
+  assert( count == expected );
+
+  // Every distinct position of the last level once, duplicates across runs were merged.
+  Board b = fen.empty() ? Board() : Board(fen);
+  struct stat level;
+  string levelPath = string(dir) + "/level-" + to_string(ply - 1) + ".frontier";
+  int found = stat(levelPath.c_str(), &level);
+  assert( found == 0 );
+  assert( level.st_size / sizeof(PackedPosition) == uniqueFrontier(b, ply - 1, nullptr).size() );
+
+  // A finished run resumes at its last level (and counts the same).
+  assert( diskPerft(fen, ply, dir, runRecords) == expected );
+
+  // A shallower run in the same dir starts over.
+  long shallower = diskPerft(fen, ply - 1, dir, runRecords);
+  assert( shallower == Search::perft(b, ply - 1, false /* categories */, nullptr).nodes );
+
+  remove((string(dir) + "/level-" + to_string(ply - 2) + ".frontier").c_str());
+  remove((string(dir) + "/checkpoint").c_str());
+  rmdir(dir);
+}
+
+
+void verifyPerftUnique(int ply, vector<long> expected, string fen) {
+  Board b = fen.empty() ? Board() : Board(fen);
+
+  vector<long> uniqueCounts;
+  uniqueFrontier(b, ply, &uniqueCounts);
+  for (int level = 0; level <= ply; level++) {
+    cout << "Unique positions at depth " << level << ": " << uniqueCounts[level] << endl;
+    assert( uniqueCounts[level] == expected[level] );
+  }
+}
+
+
 void playGame(int numMoves, int nodes, string fen) {
   Board b;
   if (!fen.empty()) {
@@ -237,6 +423,31 @@ int main(int argc, char *argv[]) {
           {{5, 17251342}, {6, 490103130}, {7, 14794751816}},
           "rnb1kbnr/pp1pp1pp/1qp2p2/8/Q1P5/N7/PP1PPPPP/1RB1KBNR b Kkq - 2 4");
 
+    verifyPerftCategories(4, 197281, 1576, 0, 0, 0, 469, 8, "");
+    verifyPerftCategories(3, 97862, 17102, 45, 3162, 0, 993, 1,
+          "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 0");
+    verifyPerftCategories(5, 674624, 52051, 1165, 0, 0, 52950, 0,
+          "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 0");
+    verifyPerftCategories(4, 422333, 131393, 0, 7795, 60032, 15492, 5,
+          "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 0");
+
+    // Distinct positions from the start, more than OEIS A083276 (1, 20, 400, 5362, 72078) as
+    // our zobrist has the en passant file after every double pawn push.
+    verifyPerftUnique(4, {1, 20, 400, 7602, 101240}, "");
+    verifyPerftHashed(6, 119060324, "");
+    verifyPackPosition(3, "");
+    verifyPackPosition(2,
+          "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 0");
+    verifyDiskPerft(4, 197281, 1 << 16, "");
+    // Small runs, so levels are merged from many runs (with duplicates across them).
+    verifyDiskPerft(5, 4865609, 64, "");
+    verifyDiskPerft(3, 97862, 1 << 16,
+          "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 0");
+    // En passant target in the fen.
+    verifyDiskPerft(3, 28312, 1 << 16, "rnbqkb1r/ppp1pppp/5n2/3pP3/8/8/PPPP1PPP/RNBQKBNR w KQkq d6 0 3");
+    verifyPerftHashed(5, 193690690,
+          "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 0");
+
     cout << "Verified Perft" << endl;
   }
 
@@ -267,7 +478,7 @@ int main(int argc, char *argv[]) {
     // En Passant verification.
     assert (verifySeriesOfMoves(
         "a4 h6   a5 b5",
-        "rnbqkbnr/p1ppppp1/7p/Pp6/8/8/1PPPPPPP/RNBQKBNR w KQkq - 0 3",
+        "rnbqkbnr/p1ppppp1/7p/Pp6/8/8/1PPPPPPP/RNBQKBNR w KQkq b6 0 3",
         0xde68558cff2df99c));
 
     // Same board position but with no En Passant.
@@ -276,6 +487,16 @@ int main(int argc, char *argv[]) {
         "rnbqkbnr/p1ppppp1/7p/Pp6/8/8/1PPPPPPP/RNBQKBNR w KQkq - 4 5",
         0xde68558cff2df99c ^ POLYGLOT_RANDOM[772 + 1]));
 
+    // Undefended pawn.
+    assert (verifyStaticExchange(
+        "1k1r4/1pp4p/p7/4p3/8/P5P1/1PP4P/2K1R3 w - - 0 1", "Rxe5", 100));
+    // Pawn for a knight (the rook x-rays through the knight).
+    assert (verifyStaticExchange(
+        "1k1r3q/1ppn3p/p4b2/4p3/8/P2N2P1/1PP1R1BP/2K1Q3 w - - 0 1", "Nxe5", -220));
+    // Queen takes a pawn defended by a pawn.
+    assert (verifyStaticExchange(
+        "4k3/8/3p4/4p3/8/8/8/4QK2 w - - 0 1", "Qxe5+", -800));
+
     cout << "Verified Simple" << endl;
   }
 
@@ -298,6 +519,9 @@ int main(int argc, char *argv[]) {
         "Qxc8 Kg6  Qe6",
         Board::RESULT_TIE));
 
+    // Passing into a position without moves isn't a stalemate.
+    assert (verifyNullMoveNoMoves());
+
     // Add three-fold.
     // Add 50 move.
 
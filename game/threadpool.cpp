@@ -0,0 +1,193 @@
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <functional>
+#include <thread>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "flags.h"
+#include "threadpool.h"
+
+using namespace std;
+
+namespace threadpool {
+  // Index of the worker running on this thread, -1 on threads outside the pool.
+  static thread_local int workerIndex = -1;
+
+
+  ThreadPool::ThreadPool(int numWorkers, bool pinThreads) {
+    assert( numWorkers >= 1 );
+    queued = 0;
+    stopping = false;
+    nextQueue = 0;
+
+    for (int i = 0; i < numWorkers; i++) {
+      queues.emplace_back(new WorkerQueue());
+    }
+    for (int i = 0; i < numWorkers; i++) {
+      workers.push_back(thread(&ThreadPool::workerLoop, this, i, pinThreads));
+    }
+  }
+
+
+  ThreadPool::~ThreadPool() {
+    {
+      lock_guard<mutex> guard(idleLock);
+      stopping = true;
+    }
+    idle.notify_all();
+
+    for (thread& worker : workers) {
+      worker.join();
+    }
+  }
+
+
+  int ThreadPool::size(void) const {
+    return workers.size();
+  }
+
+
+  void ThreadPool::submit(task_t task) {
+    int index = workerIndex >= 0 ? workerIndex : (nextQueue++ % queues.size());
+    {
+      lock_guard<mutex> guard(queues[index]->lock);
+      queues[index]->tasks.push_back(move(task));
+    }
+    queued++;
+
+    // Taking the lock orders this with a worker checking queued before it sleeps.
+    {
+      lock_guard<mutex> guard(idleLock);
+    }
+    idle.notify_one();
+  }
+
+
+  bool ThreadPool::runPendingTask(void) {
+    task_t task;
+    if (!popTask(workerIndex, &task)) {
+      return false;
+    }
+    task();
+    return true;
+  }
+
+
+  bool ThreadPool::popTask(int index, task_t *task) {
+    if (queued == 0) {
+      return false;
+    }
+
+    // Newest of our own (its data is most likely still in cache).
+    if (index >= 0) {
+      WorkerQueue& own = *queues[index];
+      lock_guard<mutex> guard(own.lock);
+      if (!own.tasks.empty()) {
+        *task = move(own.tasks.back());
+        own.tasks.pop_back();
+        queued--;
+        return true;
+      }
+    }
+
+    // Oldest of someone else's (usually the biggest piece of work).
+    int numQueues = queues.size();
+    int start = max(index, 0);
+    for (int offset = 1; offset <= numQueues; offset++) {
+      int victim = (start + offset) % numQueues;
+      if (victim == index) {
+        continue;
+      }
+      WorkerQueue& other = *queues[victim];
+      lock_guard<mutex> guard(other.lock);
+      if (!other.tasks.empty()) {
+        *task = move(other.tasks.front());
+        other.tasks.pop_front();
+        queued--;
+        return true;
+      }
+    }
+    return false;
+  }
+
+
+  void ThreadPool::workerLoop(int index, bool pinThread) {
+    workerIndex = index;
+
+#ifdef __linux__
+    if (pinThread) {
+      cpu_set_t cpus;
+      CPU_ZERO(&cpus);
+      CPU_SET(index % max(1u, thread::hardware_concurrency()), &cpus);
+      pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+    }
+#endif
+
+    while (true) {
+      task_t task;
+      if (popTask(index, &task)) {
+        task();
+        continue;
+      }
+
+      unique_lock<mutex> guard(idleLock);
+      idle.wait(guard, [this]() { return stopping || queued > 0; });
+      if (stopping && queued == 0) {
+        return;
+      }
+    }
+  }
+
+
+  TaskGroup::TaskGroup(ThreadPool& pool) : pool(pool) {
+    pending = 0;
+  }
+
+
+  TaskGroup::~TaskGroup() {
+    wait();
+  }
+
+
+  void TaskGroup::run(task_t task) {
+    pending++;
+    pool.submit([this, task]() {
+      task();
+
+      lock_guard<mutex> guard(doneLock);
+      if (--pending == 0) {
+        done.notify_all();
+      }
+    });
+  }
+
+
+  void TaskGroup::wait(void) {
+    while (pending > 0) {
+      if (pool.runPendingTask()) {
+        continue;
+      }
+
+      // Our tasks are all running elsewhere, check back for new work now and then.
+      unique_lock<mutex> guard(doneLock);
+      done.wait_for(guard, chrono::milliseconds(1), [this]() { return pending == 0; });
+    }
+
+    // The last task may still hold doneLock (and the group can be destroyed after this).
+    lock_guard<mutex> guard(doneLock);
+  }
+
+
+  ThreadPool& globalPool(void) {
+    static ThreadPool pool(
+        max(FLAGS_threads, FLAGS_pool_threads > 0 ?
+            FLAGS_pool_threads : (int) max(1u, thread::hardware_concurrency())),
+        FLAGS_pin_threads);
+    return pool;
+  }
+}
@@ -0,0 +1,76 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace threadpool {
+  typedef function<void(void)> task_t;
+
+  // Fixed set of workers started once. Each worker has its own deque, it runs its newest task
+  // first and steals the oldest task of another worker when it runs out.
+  class ThreadPool {
+    public:
+      ThreadPool(int numWorkers, bool pinThreads);
+      ~ThreadPool();
+
+      int size(void) const;
+
+      // From a worker onto its own deque, from other threads round robin.
+      void submit(task_t task);
+      // Runs one queued task (own deque first, then steals), false if there was none.
+      bool runPendingTask(void);
+
+    private:
+      struct WorkerQueue {
+        mutex lock;
+        deque<task_t> tasks;
+      };
+
+      void workerLoop(int index, bool pinThread);
+      bool popTask(int index, task_t *task);
+
+      vector<unique_ptr<WorkerQueue>> queues;
+      vector<thread> workers;
+
+      // Idle workers sleep till something is queued.
+      mutex idleLock;
+      condition_variable idle;
+      atomic<int> queued;
+      atomic<bool> stopping;
+      atomic<unsigned int> nextQueue;
+  };
+
+  // Tasks that are waited on together.
+  class TaskGroup {
+    public:
+      explicit TaskGroup(ThreadPool& pool);
+      // Waits for anything still running.
+      ~TaskGroup();
+
+      void run(task_t task);
+      // Runs queued tasks (of any group) till all of this group's are done, so waiting from
+      // inside a task doesn't tie up a worker.
+      void wait(void);
+
+    private:
+      ThreadPool& pool;
+      atomic<int> pending;
+      mutex doneLock;
+      condition_variable done;
+  };
+
+  // Shared by search and perft, started on first use with --pool_threads workers (at least
+  // --threads) and pinned to cores with --pin_threads.
+  ThreadPool& globalPool(void);
+}
+
+#endif // THREADPOOL_H
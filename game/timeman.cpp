@@ -0,0 +1,107 @@
+#include <algorithm>
+
+#include "board.h"
+#include "flags.h"
+#include "timeman.h"
+
+using namespace std;
+using namespace board;
+using namespace search;
+
+// Passed by reference to max.
+const int TimeManager::MIN_MOVES_TO_GO;
+const long TimeManager::MIN_TIME;
+
+
+TimeManager::TimeManager() {
+  reset();
+}
+
+
+void TimeManager::reset(void) {
+  baseTime = MIN_TIME;
+  maxTime = MIN_TIME;
+  scale = 1.0;
+  lastBestMove = Board::NULL_MOVE;
+  lastScore = 0;
+  stableIterations = 0;
+  bestMoveChanges = 0;
+
+  overhead = FLAGS_move_overhead;
+  lastClock = -1;
+  lastSearchTime = 0;
+}
+
+
+void TimeManager::startSearch(long clock, int movesPlayed) {
+  long increment = FLAGS_time_increment;
+
+  // Our clock only runs on our turn, whatever it lost besides the search is overhead.
+  if (lastClock >= 0) {
+    long measured = lastClock + increment - lastSearchTime - clock;
+    // Clocks are displayed in coarse steps, average and never go under the flag.
+    long averaged = (3 * overhead + measured) / 4;
+    overhead = min(1000L, max((long) FLAGS_move_overhead, averaged));
+  }
+  lastClock = clock;
+
+  int movesToGo = max(MIN_MOVES_TO_GO, MOVES_TO_GO - movesPlayed / 2);
+  long available = max(0L, clock - overhead);
+
+  long share = available / movesToGo + 3 * increment / 4;
+  maxTime = max(MIN_TIME, min((long) (MAX_CLOCK_FRACTION * available), (long) (MAX_SCALE * share)));
+  baseTime = max(MIN_TIME, min(share, maxTime));
+
+  scale = 1.0;
+  lastBestMove = Board::NULL_MOVE;
+  lastScore = 0;
+  stableIterations = 0;
+  bestMoveChanges = 0;
+}
+
+
+void TimeManager::endSearch(long searchTime) {
+  lastSearchTime = searchTime;
+}
+
+
+void TimeManager::iterationDone(move_t bestMove, int score) {
+  bool changed = lastBestMove != Board::NULL_MOVE && bestMove != lastBestMove;
+  bool dropped = lastBestMove != Board::NULL_MOVE && lastScore - score >= SCORE_DROP;
+
+  bestMoveChanges = bestMoveChanges / 2 + (changed ? 1 : 0);
+  stableIterations = (bestMove == lastBestMove) ? stableIterations + 1 : 0;
+  lastBestMove = bestMove;
+  lastScore = score;
+
+  // Unsettled positions get more time, settled ones give some back.
+  scale = 1.0 + bestMoveChanges;
+  if (dropped) {
+    scale *= 1.5;
+  }
+  if (stableIterations >= STABLE_ITERATIONS) {
+    scale *= 0.5;
+  }
+}
+
+
+bool TimeManager::shouldStop(long elapsed, long nextIteration) const {
+  // Don't start an iteration that would be cut off or run well past the plan.
+  long optimum = optimumTime();
+  return elapsed >= optimum || elapsed + nextIteration >= min(maxTime, 2 * optimum);
+}
+
+
+long TimeManager::optimumTime(void) const {
+  return min(maxTime, (long) (scale * baseTime));
+}
+
+
+long TimeManager::maximumTime(void) const {
+  return maxTime;
+}
+
+
+long TimeManager::moveOverhead(void) const {
+  return overhead;
+}
@@ -0,0 +1,69 @@
+#ifndef TIMEMAN_H
+#define TIMEMAN_H
+
+#include "board.h"
+
+using namespace std;
+using namespace board;
+
+namespace search {
+  // Splits our clock between moves and, within a move, decides when iterative deepening stops.
+  // Times are in millis.
+  class TimeManager {
+    public:
+      // Games are assumed to last at least this many more moves.
+      static const int MIN_MOVES_TO_GO = 20;
+      // Expected length of a game (in moves), early moves plan for the rest of it.
+      static const int MOVES_TO_GO = 50;
+      // A single move never gets more than this fraction of the clock.
+      static constexpr double MAX_CLOCK_FRACTION = 0.25;
+      // Nor more than this many times its share.
+      static constexpr double MAX_SCALE = 4.0;
+      // Stop early once the best move has survived this many iterations in a row.
+      static const int STABLE_ITERATIONS = 4;
+      // Centipawns the score has to fall in one iteration to think longer.
+      static const int SCORE_DROP = 30;
+      static const long MIN_TIME = 10;
+
+      TimeManager();
+
+      // New game, forgets the measured move overhead.
+      void reset(void);
+
+      // Our clock as read when the search started, movesPlayed is plies from the start.
+      void startSearch(long clock, int movesPlayed);
+      // After the move is played, searchTime is how long the search took.
+      void endSearch(long searchTime);
+
+      // After every finished iteration, score is from the side to move's point of view.
+      void iterationDone(move_t bestMove, int score);
+      // elapsed since the search started, nextIteration is the expected cost of another one.
+      bool shouldStop(long elapsed, long nextIteration) const;
+
+      // Time this move is planned to take (so far, changes with iterationDone).
+      long optimumTime(void) const;
+      // Hard limit, the search is interrupted past this.
+      long maximumTime(void) const;
+      long moveOverhead(void) const;
+
+    private:
+      // Planned time before search signals, see iterationDone.
+      long baseTime;
+      long maxTime;
+      double scale;
+
+      move_t lastBestMove;
+      int lastScore;
+      int stableIterations;
+      // Decaying count of best move changes (halved every iteration).
+      double bestMoveChanges;
+
+      // Time lost per move outside of the search (network, clicking the move), measured from how
+      // much our clock drops between searches. lastClock is -1 till there is a measurement.
+      long overhead;
+      long lastClock;
+      long lastSearchTime;
+  };
+}
+
+#endif // TIMEMAN_H
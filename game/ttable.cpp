@@ -1,48 +1,165 @@
+#include <atomic>
 #include <cassert>
-#include <unordered_map>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
 
+#include "flags.h"
 #include "ttable.h"
 
 using namespace std;
 using namespace board;
 
 namespace ttable {
-  unordered_map<board_hash_t, TTableEntry* > globalTT;
-  int globalHistory[2][64][64] = {};
+  TTableBucket* globalTT = nullptr;
+  uint64_t globalTTMask = 0;
+  int globalTTMegabytes = 0;
+  // Age of entries stored by the current search (6 bits).
+  uint64_t globalGeneration = 0;
 
-  void clearTT() {
-    globalTT.clear();
+  // data layout: score (0-15), move (16-37), depth (38-45), type (46-47), generation (48-53).
+  static uint64_t packEntry(const TTableEntry& entry) {
+    assert( -32768 <= entry.score && entry.score <= 32767 );
+    assert( entry.suggested < (1 << 22) );
+    assert( 0 <= entry.depth );
+    return ((uint64_t) (uint16_t) entry.score) |
+           ((uint64_t) entry.suggested << 16) |
+           ((uint64_t) (uint8_t) entry.depth << 38) |
+           ((uint64_t) entry.type << 46) |
+           (globalGeneration << 48);
+  }
+
+  static TTableEntry unpackEntry(uint64_t data) {
+    TTableEntry entry;
+    entry.score = (int16_t) (data & 0xFFFF);
+    entry.suggested = (data >> 16) & ((1 << 22) - 1);
+    entry.depth = (data >> 38) & 0xFF;
+    entry.type = (data >> 46) & 3;
+    return entry;
   }
 
-  int sizeTT() {
-    return globalTT.size();
+  static int entryDepth(uint64_t data) {
+    return (data >> 38) & 0xFF;
   }
 
-  void storeTT(board_hash_t position, TTableEntry* entry) {
-    globalTT[position] = entry;
+  static int entryAge(uint64_t data) {
+    return (globalGeneration - (data >> 48)) & 63;
   }
 
-  TTableEntry* lookupTT(board_hash_t position) {
-    auto test = globalTT.find(position);
-    return (test != globalTT.end()) ?
-      test->second : nullptr;
+  static TTableBucket& bucketFor(board_hash_t position) {
+    // Low bits also pick the book and polyglot entries, high bits are less correlated.
+    return globalTT[(position >> 32) & globalTTMask];
   }
 
-  void clearHistory() {
-    for (int color = 0; color < 2; color++) {
-      for (int from = 0; from < 64; from++) {
-        for (int to = 0; to < 64; to++) {
-          globalHistory[color][from][to] = 0;
-        }
+  void resizeTT(int megabytes) {
+    free(globalTT);
+
+    uint64_t buckets = 1;
+    while (2 * buckets * sizeof(TTableBucket) <= ((uint64_t) megabytes << 20)) {
+      buckets *= 2;
+    }
+
+    void* memory = nullptr;
+    if (posix_memalign(&memory, sizeof(TTableBucket), buckets * sizeof(TTableBucket)) != 0) {
+      cout << "Failed to allocate " << megabytes << "MB transposition table" << endl;
+      exit(1);
+    }
+
+    globalTT = static_cast<TTableBucket*>(memory);
+    globalTTMask = buckets - 1;
+    globalTTMegabytes = megabytes;
+
+    for (uint64_t b = 0; b < buckets; b++) {
+      for (TTableSlot& slot : globalTT[b].slots) {
+        slot.key.store(0, memory_order_relaxed);
+        slot.data.store(0, memory_order_relaxed);
       }
     }
   }
 
-  void updateHistory(bool isWhite, int from, int to, int delta) {
-    globalHistory[isWhite][from][to] += delta;
+  void clearTT() {
+    // Reallocating also clears.
+    if (globalTT == nullptr || globalTTMegabytes != FLAGS_ttable_mb) {
+      resizeTT(FLAGS_ttable_mb);
+      return;
+    }
+
+    for (uint64_t b = 0; b <= globalTTMask; b++) {
+      for (TTableSlot& slot : globalTT[b].slots) {
+        slot.key.store(0, memory_order_relaxed);
+        slot.data.store(0, memory_order_relaxed);
+      }
+    }
   }
 
-  int lookupHistory(bool isWhite, int from, int to) {
-    return globalHistory[isWhite][from][to];
+  void newSearchTT() {
+    if (globalTT == nullptr || globalTTMegabytes != FLAGS_ttable_mb) {
+      resizeTT(FLAGS_ttable_mb);
+    }
+    globalGeneration = (globalGeneration + 1) & 63;
+  }
+
+  int hashfullTT() {
+    if (globalTT == nullptr) {
+      return 0;
+    }
+
+    int used = 0;
+    int sampled = 0;
+    for (uint64_t b = 0; b <= globalTTMask && sampled < 1000; b++) {
+      for (TTableSlot& slot : globalTT[b].slots) {
+        uint64_t data = slot.data.load(memory_order_relaxed);
+        used += (data != 0 && entryAge(data) == 0);
+        sampled++;
+      }
+    }
+    return 1000 * used / sampled;
+  }
+
+  void storeTT(board_hash_t position, const TTableEntry& entry) {
+    if (globalTT == nullptr) {
+      return;
+    }
+
+    TTableBucket& bucket = bucketFor(position);
+
+    // Same position, else the shallowest (older entries count as shallower) slot.
+    TTableSlot* replace = &bucket.slots[0];
+    int replaceValue = 1 << 30;
+    for (TTableSlot& slot : bucket.slots) {
+      uint64_t data = slot.data.load(memory_order_relaxed);
+      uint64_t key = slot.key.load(memory_order_relaxed);
+      if ((key ^ data) == position || data == 0) {
+        replace = &slot;
+        break;
+      }
+
+      int value = entryDepth(data) - 8 * entryAge(data);
+      if (value < replaceValue) {
+        replaceValue = value;
+        replace = &slot;
+      }
+    }
+
+    uint64_t data = packEntry(entry);
+    replace->key.store(position ^ data, memory_order_relaxed);
+    replace->data.store(data, memory_order_relaxed);
+  }
+
+  bool lookupTT(board_hash_t position, TTableEntry* entry) {
+    if (globalTT == nullptr) {
+      return false;
+    }
+
+    TTableBucket& bucket = bucketFor(position);
+    for (TTableSlot& slot : bucket.slots) {
+      uint64_t data = slot.data.load(memory_order_relaxed);
+      uint64_t key = slot.key.load(memory_order_relaxed);
+      if (data != 0 && (key ^ data) == position) {
+        *entry = unpackEntry(data);
+        return true;
+      }
+    }
+    return false;
   }
 }
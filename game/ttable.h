@@ -1,7 +1,8 @@
 #ifndef TTABLE_H
 #define TTABLE_H
 
-#include <unordered_map>
+#include <atomic>
+#include <cstdint>
 
 #include "board.h"
 
@@ -21,15 +22,32 @@ namespace ttable {
     move_t suggested;
   };
 
-  void clearTT(void);
-  int sizeTT(void);
+  // Entry packed in data, key is stored as (zobrist ^ data) so a torn write from another
+  // thread fails the lookup instead of returning someone else's entry (no locks needed).
+  struct TTableSlot {
+    atomic<uint64_t> key;
+    atomic<uint64_t> data;
+  };
 
-  void storeTT(board_hash_t position, TTableEntry* entry);
-  TTableEntry* lookupTT(board_hash_t position);
+  // One cache line per probe.
+  const int TT_BUCKET_SLOTS = 4;
+  struct alignas(64) TTableBucket {
+    TTableSlot slots[TT_BUCKET_SLOTS];
+  };
 
-  void clearHistory(void);
-  void updateHistory(bool isWhite, int from, int to, int delta);
-  int lookupHistory(bool isWhite, int from, int to);
+  // Allocates (power of two buckets <= megabytes) and clears.
+  void resizeTT(int megabytes);
+  // Clears every entry (allocates with --ttable_mb if needed), for a new game.
+  void clearTT(void);
+  // Entries are kept between searches (moves of one game), entries from older searches are
+  // replaced first. Allocates with --ttable_mb if needed.
+  void newSearchTT(void);
+  // Permille of sampled slots used (by this search).
+  int hashfullTT(void);
+
+  // Safe to call from many threads.
+  void storeTT(board_hash_t position, const TTableEntry& entry);
+  bool lookupTT(board_hash_t position, TTableEntry* entry);
 }
 
 #endif // TTABLE_H